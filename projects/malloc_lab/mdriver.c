@@ -14,7 +14,16 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
 #include <time.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -30,6 +39,12 @@
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
+#define MAXTHREADS    64 /* max number of threads in parallel mode (-p) */
+#define LATBUCKETS    32 /* log2 buckets in the latency histograms (-L) */
+#define NCOUNTERS      3 /* hardware counters reported by -L */
+#define FRAGBUCKETS   15 /* log2 buckets of free block sizes (-F) ... */
+#define FRAGMINSHIFT   3 /* ... starting at 2^3 bytes */
+
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
 
@@ -37,11 +52,16 @@
  * The key compound data types 
  *****************************/
 
-/* Records the extent of each block's payload */
+/* 
+ * Records the extent of each block's payload. The ranges of a trace
+ * never overlap, so they are kept in an AVL tree ordered by address.
+ */
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    struct range_t *left;  /* ranges at lower addresses */
+    struct range_t *right; /* ranges at higher addresses */
+    int height;            /* height of the subtree rooted here */
 } range_t;
 
 /* Characterizes a single trace operation (allocator request) */
@@ -72,6 +92,59 @@ typedef struct {
     range_t *ranges;
 } speed_t;
 
+/* 
+ * Holds the params to eval_mm_parallel, which replays one copy of the
+ * trace per thread. Each thread gets its own blocks array, so the
+ * copies share the allocator but not the request ids. The threads are
+ * created before timing starts and wait on the start barrier, so a
+ * timed run covers only the replays themselves.
+ */
+typedef struct par_speed par_speed_t;
+
+#ifdef MM_THREADS
+typedef struct {
+    par_speed_t *params;
+    trace_t trace;             /* shares the ops array, has its own blocks */
+    char *msg;                 /* error from the last replay, or NULL */
+    pthread_t tid;
+} par_thread_t;
+#endif
+
+struct par_speed {
+    trace_t *trace;            /* the trace every thread replays */
+    int nthreads;              /* how many threads to run */
+    char **blocks[MAXTHREADS];
+    int failed;                /* set if some copy ran out of heap */
+#ifdef MM_THREADS
+    par_thread_t threads[MAXTHREADS];
+    pthread_barrier_t start;   /* releases the threads into a replay */
+    pthread_barrier_t done;    /* waits for every thread to finish it */
+    int quit;                  /* tells the threads to exit at start */
+#endif
+};
+
+/* 
+ * Per-request latencies, in nanoseconds, of one kind of request
+ * (indexed by the type field of traceop_t) 
+ */
+typedef struct {
+    long *ns;                /* latency of each request in one trace */
+    int n;                   /* number of requests in ns */
+    long hist[LATBUCKETS];   /* histogram over all traces: [2^b, 2^(b+1)) */
+} latency_t;
+
+/* 
+ * The shape of the heap at one point in a trace, added up by frag_visit
+ * while the mm package walks its heap (-F)
+ */
+typedef struct {
+    long alloc_bytes;       /* bytes in allocated blocks, headers included */
+    long free_bytes;        /* bytes in free blocks */
+    long free_blocks;       /* number of free blocks */
+    long largest_free;      /* size of the largest free block */
+    long hist[FRAGBUCKETS]; /* free blocks of [2^(b+3), 2^(b+4)) bytes */
+} frag_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* defined for both libc malloc and student malloc package (mm.c) */
@@ -92,6 +165,8 @@ int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
+static frag_t frag;     /* heap shape filled in by frag_visit (-F) */
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -105,11 +180,17 @@ static char *default_tracefiles[] = {
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate range trees */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *find_overlap(range_t *root, char *lo, char *hi);
+static range_t *insert_range(range_t *root, range_t *node);
+static range_t *delete_range(range_t *root, char *lo, range_t **deleted);
+static range_t *balance_range(range_t *p);
+static range_t *rotate_range(range_t *p, int right);
+static void free_ranges(range_t *root);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
@@ -124,6 +205,34 @@ static void eval_libc_speed(void *ptr);
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static char *replay_trace(trace_t *trace);
+
+/* Routines for measuring the mm package with concurrent threads (-p) */
+#ifdef MM_THREADS
+static void start_threads(par_speed_t *params);
+static void stop_threads(par_speed_t *params);
+static void eval_mm_parallel(void *ptr);
+static void *replay_thread(void *ptr);
+#endif
+static void run_parallel(char **tracefiles, int num_tracefiles, 
+			 stats_t *mm_stats, int max_threads);
+
+/* Routines for the request latency and hardware counter report (-L) */
+static void run_latency(char **tracefiles, int num_tracefiles, 
+			stats_t *mm_stats);
+static void eval_mm_latency(trace_t *trace, latency_t *lat, long overhead);
+static long time_ns(void);
+static long timer_overhead(void);
+static int cmp_long(const void *a, const void *b);
+static int open_counters(int *fds);
+static void eval_mm_counters(trace_t *trace, int *fds, long long *counts);
+
+/* Routines for the heap fragmentation profile (-F) */
+static void run_frag(char **tracefiles, int num_tracefiles, 
+		     stats_t *mm_stats, int interval, char *filename);
+static void eval_mm_frag(trace_t *trace, char *name, int interval, FILE *fp);
+static void sample_heap(trace_t *trace, char *name, int opnum, FILE *fp);
+static void frag_visit(void *bp, size_t size, int alloc);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
@@ -150,6 +259,10 @@ int main(int argc, char **argv)
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int max_threads = 0; /* If set, also replay traces in parallel (-p) */
+    int latency = 0;     /* If set, report request latencies (-L) */
+    int frag_interval = 0;           /* If set, sample the heap (-F) ... */
+    char *frag_file = "frag.csv";    /* ... into this CSV file (-o) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +271,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:p:F:o:hvVgalL")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -184,6 +297,30 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'L': /* Report request latencies and hardware counters */
+            latency = 1;
+            break;
+        case 'p': /* Replay each trace on up to <n> concurrent threads */
+#ifndef MM_THREADS
+            fprintf(stderr, "ERROR: -p needs the thread-safe allocator (make mdriver-mt)\n");
+            exit(1);
+#endif
+            max_threads = atoi(optarg);
+            if (max_threads < 1 || max_threads > MAXTHREADS) {
+                fprintf(stderr, "ERROR: -p takes 1 to %d threads\n", MAXTHREADS);
+                exit(1);
+            }
+            break;
+        case 'F': /* Sample the heap every <k> requests */
+            frag_interval = atoi(optarg);
+            if (frag_interval < 1) {
+                fprintf(stderr, "ERROR: -F takes a positive request count\n");
+                exit(1);
+            }
+            break;
+        case 'o': /* Where -F writes its samples */
+            frag_file = optarg;
+            break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -314,6 +451,19 @@ int main(int argc, char **argv)
 	printf("\n");
     }
 
+    /* Optionally measure throughput with concurrent threads */
+    if (max_threads)
+	run_parallel(tracefiles, num_tracefiles, mm_stats, max_threads);
+
+    /* Optionally break the running time down by request */
+    if (latency)
+	run_latency(tracefiles, num_tracefiles, mm_stats);
+
+    /* Optionally follow fragmentation through each trace */
+    if (frag_interval)
+	run_frag(tracefiles, num_tracefiles, mm_stats, frag_interval, 
+		 frag_file);
+
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
      */
@@ -367,16 +517,19 @@ int main(int argc, char **argv)
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps 
+ * The following routines manipulate the range tree, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks. Since the
+ * ranges in the tree are disjoint, ordering them by their low address
+ * also orders their high addresses, and an ordinary balanced search
+ * tree answers overlap queries in O(log n) time.
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ *     we create a range struct for this block and add it to the range tree. 
  */
 static int add_range(range_t **ranges, char *lo, int size, 
 		     int tracenum, int opnum)
@@ -395,9 +548,11 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap, or within
+       one of the pages that memlib has mapped for the package */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_is_mapped(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -405,26 +560,24 @@ static int add_range(range_t **ranges, char *lo, int size,
     }
 
     /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-		    lo, hi, p->lo, p->hi);
-	    malloc_error(tracenum, opnum, msg);
-	    return 0;
-        }
+    if ((p = find_overlap(*ranges, lo, hi)) != NULL) {
+	sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+		lo, hi, p->lo, p->hi);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
     }
 
     /* 
      * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
     if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
 	unix_error("malloc error in add_range");
-    p->next = *ranges;
     p->lo = lo;
     p->hi = hi;
-    *ranges = p;
+    p->left = p->right = NULL;
+    p->height = 1;
+    *ranges = insert_range(*ranges, p);
     return 1;
 }
 
@@ -433,19 +586,11 @@ static int add_range(range_t **ranges, char *lo, int size,
  */
 static void remove_range(range_t **ranges, char *lo)
 {
-    range_t *p;
-    range_t **prevpp = ranges;
-    int size;
+    range_t *p = NULL;
 
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
-    }
+    *ranges = delete_range(*ranges, lo, &p);
+    if (p != NULL)
+	free(p);
 }
 
 /*
@@ -453,14 +598,146 @@ static void remove_range(range_t **ranges, char *lo)
  */
 static void clear_ranges(range_t **ranges)
 {
-    range_t *p;
-    range_t *pnext;
+    free_ranges(*ranges);
+    *ranges = NULL;
+}
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+/*
+ * find_overlap - Return some range in the tree that shares a byte
+ *     with lo:hi, or NULL if there is none. A range that ends below lo
+ *     rules out its whole left subtree, and one that starts above hi
+ *     rules out its right subtree, so a single descent suffices.
+ */
+static range_t *find_overlap(range_t *root, char *lo, char *hi)
+{
+    range_t *p = root;
+
+    while (p != NULL) {
+	if (p->hi < lo)
+	    p = p->right;
+	else if (p->lo > hi)
+	    p = p->left;
+	else
+	    return p;
     }
-    *ranges = NULL;
+    return NULL;
+}
+
+/* Height of a possibly empty subtree */
+#define RANGE_HEIGHT(p) ((p) == NULL ? 0 : (p)->height)
+
+/*
+ * insert_range - Add node to the subtree at root and return the new,
+ *     rebalanced subtree root.
+ */
+static range_t *insert_range(range_t *root, range_t *node)
+{
+    if (root == NULL)
+	return node;
+    if (node->lo < root->lo)
+	root->left = insert_range(root->left, node);
+    else
+	root->right = insert_range(root->right, node);
+    return balance_range(root);
+}
+
+/*
+ * delete_range - Unlink the range starting at lo from the subtree at
+ *     root, hand it back in *deleted, and return the new subtree root.
+ *     The tree is left untouched if no such range exists.
+ */
+static range_t *delete_range(range_t *root, char *lo, range_t **deleted)
+{
+    range_t *succ;
+
+    if (root == NULL)
+	return NULL;
+    if (lo < root->lo) {
+	root->left = delete_range(root->left, lo, deleted);
+    }
+    else if (lo > root->lo) {
+	root->right = delete_range(root->right, lo, deleted);
+    }
+    else {
+	*deleted = root;
+	if (root->left == NULL)
+	    return root->right;
+	if (root->right == NULL)
+	    return root->left;
+
+	/* Two children: replace root by its in-order successor */
+	for (succ = root->right; succ->left != NULL; succ = succ->left)
+	    ;
+	root->right = delete_range(root->right, succ->lo, &succ);
+	succ->left = root->left;
+	succ->right = root->right;
+	root = succ;
+    }
+    return balance_range(root);
+}
+
+/*
+ * balance_range - Restore the AVL property at p, whose subtrees are
+ *     balanced and differ in height by at most two, and return the
+ *     subtree root that replaces p.
+ */
+static range_t *balance_range(range_t *p)
+{
+    int lh = RANGE_HEIGHT(p->left);
+    int rh = RANGE_HEIGHT(p->right);
+
+    if (lh > rh + 1) {
+	if (RANGE_HEIGHT(p->left->left) < RANGE_HEIGHT(p->left->right))
+	    p->left = rotate_range(p->left, 0);
+	return rotate_range(p, 1);
+    }
+    if (rh > lh + 1) {
+	if (RANGE_HEIGHT(p->right->right) < RANGE_HEIGHT(p->right->left))
+	    p->right = rotate_range(p->right, 1);
+	return rotate_range(p, 0);
+    }
+    p->height = (lh > rh ? lh : rh) + 1;
+    return p;
+}
+
+/*
+ * rotate_range - Rotate the subtree at p to the right (right != 0) or
+ *     to the left, fixing up heights, and return the new subtree root.
+ */
+static range_t *rotate_range(range_t *p, int right)
+{
+    range_t *q;
+    int lh, rh;
+
+    if (right) {
+	q = p->left;
+	p->left = q->right;
+	q->right = p;
+    }
+    else {
+	q = p->right;
+	p->right = q->left;
+	q->left = p;
+    }
+    lh = RANGE_HEIGHT(p->left);
+    rh = RANGE_HEIGHT(p->right);
+    p->height = (lh > rh ? lh : rh) + 1;
+    lh = RANGE_HEIGHT(q->left);
+    rh = RANGE_HEIGHT(q->right);
+    q->height = (lh > rh ? lh : rh) + 1;
+    return q;
+}
+
+/*
+ * free_ranges - Free every range record in the subtree at root 
+ */
+static void free_ranges(range_t *root)
+{
+    if (root == NULL)
+	return;
+    free_ranges(root->left);
+    free_ranges(root->right);
+    free(root);
 }
 
 
@@ -584,7 +861,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     char *oldp;
     char *p;
     
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap and free any records in the range tree */
     mem_reset_brk();
     clear_ranges(ranges);
 
@@ -611,7 +888,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    /* 
 	     * Test the range of the new block for correctness and add it 
-	     * to the range list if OK. The block must be  be aligned properly,
+	     * to the range tree if OK. The block must be  be aligned properly,
 	     * and must not overlap any currently allocated block. 
 	     */ 
 	    if (add_range(ranges, p, size, tracenum, i) == 0)
@@ -638,10 +915,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		return 0;
 	    }
 	    
-	    /* Remove the old region from the range list */
+	    /* Remove the old region from the range tree */
 	    remove_range(ranges, oldp);
 	    
-	    /* Check new block for correctness and add it to range list */
+	    /* Check new block for correctness and add it to range tree */
 	    if (add_range(ranges, newp, size, tracenum, i) == 0)
 		return 0;
 	    
@@ -653,7 +930,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -774,7 +1051,9 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    /* The heap may have shrunk and mappings may be gone by now, so
+       compare against the largest footprint the package ever had */
+    return ((double)max_total_size / (double)mem_peak_heapsize());
 }
 
 
@@ -784,15 +1063,28 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
-    char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
+    char *msg;
 
     /* Reset the heap and initialize the mm package */
     mem_reset_brk();
     if (mm_init() < 0) 
 	app_error("mm_init failed in eval_mm_speed");
 
+    if ((msg = replay_trace(trace)) != NULL)
+	app_error(msg);
+}
+
+/*
+ * replay_trace - Run every request of the trace against the mm package,
+ *    without any checking. Shared by the serial and parallel timers.
+ *    Returns NULL on success, or an error message if a request failed.
+ */
+static char *replay_trace(trace_t *trace)
+{
+    int i, index, size, newsize;
+    char *p, *newp, *oldp, *block;
+
     /* Interpret each trace request */
     for (i = 0;  i < trace->num_ops;  i++)
         switch (trace->ops[i].type) {
@@ -801,7 +1093,7 @@ static void eval_mm_speed(void *ptr)
             index = trace->ops[i].index;
             size = trace->ops[i].size;
             if ((p = mm_malloc(size)) == NULL)
-		app_error("mm_malloc error in eval_mm_speed");
+		return "mm_malloc error in eval_mm_speed";
             trace->blocks[index] = p;
             break;
 
@@ -810,7 +1102,7 @@ static void eval_mm_speed(void *ptr)
             newsize = trace->ops[i].size;
 	    oldp = trace->blocks[index];
             if ((newp = mm_realloc(oldp,newsize)) == NULL)
-		app_error("mm_realloc error in eval_mm_speed");
+		return "mm_realloc error in eval_mm_speed";
             trace->blocks[index] = newp;
             break;
 
@@ -821,8 +1113,576 @@ static void eval_mm_speed(void *ptr)
             break;
 
 	default:
-	    app_error("Nonexistent request type in eval_mm_valid");
+	    return "Nonexistent request type in eval_mm_valid";
         }
+    return NULL;
+}
+
+/*
+ * run_parallel - Replay every valid trace on 1, 2, 4, ... max_threads
+ *    concurrent threads, each thread running its own copy of the trace,
+ *    and report the aggregate throughput for each thread count. Since
+ *    the copies share one heap, a trace stops scaling as soon as they
+ *    no longer fit in it.
+ */
+static void run_parallel(char **tracefiles, int num_tracefiles, 
+			 stats_t *mm_stats, int max_threads)
+{
+#ifdef MM_THREADS
+    int i, j, n;
+    double secs, ops;
+    trace_t *trace;
+    par_speed_t par_params;
+
+    printf("Results for mm malloc with concurrent threads:\n");
+    printf("%5s%8s%9s%10s%8s%12s\n", 
+	   "trace", "threads", "ops", "secs", "Kops", "Kops/thread");
+
+    for (i=0; i < num_tracefiles; i++) {
+	if (!mm_stats[i].valid)
+	    continue;
+	trace = read_trace(tracedir, tracefiles[i]);
+
+	/* Each thread replays the trace into its own blocks array */
+	par_params.trace = trace;
+	for (j = 0; j < max_threads; j++) {
+	    if ((par_params.blocks[j] = 
+		 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+		unix_error("malloc failed in run_parallel");
+	}
+
+	/* Thread counts 1, 2, 4, ... and finally max_threads itself */
+	for (n = 1; ; n = (n*2 < max_threads) ? n*2 : max_threads) {
+	    par_params.nthreads = n;
+	    par_params.failed = 0;
+	    start_threads(&par_params);
+	    secs = fsecs(eval_mm_parallel, &par_params);
+	    stop_threads(&par_params);
+	    if (par_params.failed) {
+		printf("%2d%11d%9s  (out of heap, skipping larger counts)\n", 
+		       i, n, "-");
+		break;
+	    }
+	    ops = (double)trace->num_ops * n;
+	    printf("%2d%11d%9.0f%10.6f%8.0f%12.0f\n", 
+		   i, n, ops, secs, (ops/1e3)/secs, (ops/1e3)/secs/n);
+	    if (n == max_threads)
+		break;
+	}
+
+	for (j = 0; j < max_threads; j++)
+	    free(par_params.blocks[j]);
+	free_trace(trace);
+    }
+    printf("\n");
+#else
+    app_error("ERROR: -p needs the thread-safe allocator (make mdriver-mt)");
+#endif
+}
+
+#ifdef MM_THREADS
+/*
+ * start_threads - Create the nthreads replay threads, which wait on
+ *    the start barrier until eval_mm_parallel releases them
+ */
+static void start_threads(par_speed_t *params)
+{
+    par_thread_t *th;
+    int i;
+
+    if (pthread_barrier_init(&params->start, NULL, params->nthreads + 1) != 0 ||
+	pthread_barrier_init(&params->done, NULL, params->nthreads + 1) != 0)
+	unix_error("pthread_barrier_init failed in start_threads");
+    params->quit = 0;
+
+    /* Threads share the ops array but remember their own blocks */
+    for (i = 0; i < params->nthreads; i++) {
+	th = &params->threads[i];
+	th->params = params;
+	th->trace = *params->trace;
+	th->trace.blocks = params->blocks[i];
+	if (pthread_create(&th->tid, NULL, replay_thread, th) != 0)
+	    unix_error("pthread_create failed in start_threads");
+    }
+}
+
+/*
+ * stop_threads - Release the replay threads one last time to exit
+ */
+static void stop_threads(par_speed_t *params)
+{
+    int i;
+
+    params->quit = 1;
+    pthread_barrier_wait(&params->start);
+    for (i = 0; i < params->nthreads; i++)
+	pthread_join(params->threads[i].tid, NULL);
+    pthread_barrier_destroy(&params->start);
+    pthread_barrier_destroy(&params->done);
+}
+
+/*
+ * eval_mm_parallel - This is the function that is used by fsecs()
+ *    to measure the running time of the mm malloc package while
+ *    nthreads threads replay the trace at the same time.
+ */
+static void eval_mm_parallel(void *ptr)
+{
+    par_speed_t *params = (par_speed_t *)ptr;
+    int i;
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_parallel");
+
+    /* All threads start together; wait until the last one is done */
+    pthread_barrier_wait(&params->start);
+    pthread_barrier_wait(&params->done);
+    for (i = 0; i < params->nthreads; i++)
+	if (params->threads[i].msg != NULL)
+	    params->failed = 1;
+}
+
+/*
+ * replay_thread - Thread routine that runs one copy of a trace each
+ *    time it passes the start barrier, until stop_threads sets quit
+ */
+static void *replay_thread(void *ptr)
+{
+    par_thread_t *th = (par_thread_t *)ptr;
+    par_speed_t *params = th->params;
+
+    for (;;) {
+	pthread_barrier_wait(&params->start);
+	if (params->quit)
+	    return NULL;
+	th->msg = replay_trace(&th->trace);
+	pthread_barrier_wait(&params->done);
+    }
+}
+#endif
+
+/*
+ * run_latency - Replay every valid trace once more, timing each request
+ *    on its own, and print latency percentiles for each kind of request,
+ *    a latency histogram over all traces, and, when the kernel lets us
+ *    read them, hardware counters per request.
+ */
+static void run_latency(char **tracefiles, int num_tracefiles, 
+			stats_t *mm_stats)
+{
+    static char *names[3] = {"malloc", "free", "realloc"};
+    static char *counter_names[NCOUNTERS] = {"instrs", "cache-miss", 
+					     "dTLB-miss"};
+    latency_t lat[3];
+    int fds[NCOUNTERS];
+    long long (*counts)[NCOUNTERS];
+    long overhead, *ns;
+    int i, k, b, lo, hi, n, ncounters;
+    trace_t *trace;
+
+    memset(lat, 0, sizeof(lat));
+    overhead = timer_overhead();
+    ncounters = open_counters(fds);
+    if ((counts = calloc(num_tracefiles, sizeof(*counts))) == NULL)
+	unix_error("calloc failed in run_latency");
+
+    /* Percentiles for each trace and kind of request */
+    printf("Request latency for mm malloc (ns, less %ld ns timer overhead):\n",
+	   overhead);
+    printf("%5s%9s%9s%7s%7s%7s%7s%9s\n", 
+	   "trace", "request", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (i=0; i < num_tracefiles; i++) {
+	if (!mm_stats[i].valid)
+	    continue;
+	trace = read_trace(tracedir, tracefiles[i]);
+	for (k = 0; k < 3; k++) {
+	    if ((lat[k].ns = (long *)malloc(trace->num_ops * sizeof(long))) == NULL)
+		unix_error("malloc failed in run_latency");
+	    lat[k].n = 0;
+	}
+
+	eval_mm_latency(trace, lat, overhead);
+	for (k = 0; k < 3; k++) {
+	    ns = lat[k].ns;
+	    if ((n = lat[k].n) > 0) {
+		qsort(ns, n, sizeof(long), cmp_long);
+		printf("%2d%12s%9d%7ld%7ld%7ld%7ld%9ld\n", i, names[k], n, 
+		       ns[(n-1)*50/100], ns[(n-1)*90/100], ns[(n-1)*99/100], 
+		       ns[(n-1)*999/1000], ns[n-1]);
+	    }
+	    free(ns);
+	}
+
+	if (ncounters > 0)
+	    eval_mm_counters(trace, fds, counts[i]);
+	free_trace(trace);
+    }
+    printf("\n");
+
+    /* Histogram from the first to the last nonempty bucket */
+    lo = LATBUCKETS;
+    hi = -1;
+    for (b = 0; b < LATBUCKETS; b++)
+	for (k = 0; k < 3; k++)
+	    if (lat[k].hist[b] != 0) {
+		lo = (b < lo) ? b : lo;
+		hi = b;
+	    }
+    printf("Request latency histogram over all traces:\n");
+    printf("%21s%10s%10s%10s\n", "ns", names[0], names[1], names[2]);
+    for (b = lo; b <= hi; b++)
+	printf("%9ld - %9ld%10ld%10ld%10ld\n", (b == 0) ? 0 : 1L << b, 
+	       (1L << (b+1)) - 1, lat[0].hist[b], lat[1].hist[b], 
+	       lat[2].hist[b]);
+    printf("\n");
+
+    /* Hardware counters, which cover the mm package and not the timer */
+    if (ncounters == 0) {
+	printf("Hardware counters unavailable (perf_event_open failed)\n\n");
+	free(counts);
+	return;
+    }
+    printf("Hardware counters per request (user mode):\n");
+    printf("%5s", "trace");
+    for (k = 0; k < NCOUNTERS; k++)
+	printf("%12s", counter_names[k]);
+    printf("\n");
+    for (i=0; i < num_tracefiles; i++) {
+	if (!mm_stats[i].valid)
+	    continue;
+	printf("%2d   ", i);
+	for (k = 0; k < NCOUNTERS; k++) {
+	    if (fds[k] < 0)
+		printf("%12s", "-");
+	    else
+		printf("%12.2f", counts[i][k] / mm_stats[i].ops);
+	}
+	printf("\n");
+    }
+    printf("\n");
+
+    for (k = 0; k < NCOUNTERS; k++)
+	if (fds[k] >= 0)
+	    close(fds[k]);
+    free(counts);
+}
+
+/*
+ * eval_mm_latency - Replay the trace, timing each request on its own.
+ *    An untimed run first warms up the heap pages and the caches.
+ */
+static void eval_mm_latency(trace_t *trace, latency_t *lat, long overhead)
+{
+    int i, k, b, index;
+    long start, ns;
+    char *p, *msg;
+
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_latency");
+    if ((msg = replay_trace(trace)) != NULL)
+	app_error(msg);
+
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_latency");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	k = trace->ops[i].type;
+        switch (k) {
+
+        case ALLOC: /* mm_malloc */
+	    start = time_ns();
+	    p = mm_malloc(trace->ops[i].size);
+	    ns = time_ns() - start;
+	    if (p == NULL)
+		app_error("mm_malloc error in eval_mm_latency");
+	    trace->blocks[index] = p;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    start = time_ns();
+	    p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+	    ns = time_ns() - start;
+	    if (p == NULL)
+		app_error("mm_realloc error in eval_mm_latency");
+	    trace->blocks[index] = p;
+	    break;
+
+        case FREE: /* mm_free */
+	    p = trace->blocks[index];
+	    start = time_ns();
+	    mm_free(p);
+	    ns = time_ns() - start;
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_latency");
+	    return;
+        }
+
+	ns = (ns > overhead) ? ns - overhead : 0;
+	lat[k].ns[lat[k].n++] = ns;
+	for (b = 0; b < LATBUCKETS - 1 && (ns >> (b+1)) != 0; b++)
+	    ;
+	lat[k].hist[b]++;
+    }
+}
+
+/*
+ * time_ns - Read the monotonic clock in nanoseconds
+ */
+static long time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/*
+ * timer_overhead - The smallest time two back-to-back clock reads
+ *    can measure, which is subtracted from every request latency
+ */
+static long timer_overhead(void)
+{
+    long start, ns, min = LONG_MAX;
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+	start = time_ns();
+	ns = time_ns() - start;
+	if (ns < min)
+	    min = ns;
+    }
+    return min;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * open_counters - Open the user-mode counters for instructions, cache 
+ *    misses and dTLB load misses on this thread, disabled. Counters the 
+ *    kernel or the CPU does not support get a descriptor of -1. Returns 
+ *    the number of counters that could be opened.
+ */
+static int open_counters(int *fds)
+{
+    int k, n = 0;
+#ifdef __linux__
+    static const unsigned types[NCOUNTERS] = {
+	PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE
+    };
+    static const unsigned long long configs[NCOUNTERS] = {
+	PERF_COUNT_HW_INSTRUCTIONS, 
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
+	(PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+    struct perf_event_attr attr;
+
+    for (k = 0; k < NCOUNTERS; k++) {
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = types[k];
+	attr.config = configs[k];
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	fds[k] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fds[k] >= 0)
+	    n++;
+    }
+#else
+    for (k = 0; k < NCOUNTERS; k++)
+	fds[k] = -1;
+#endif
+    return n;
+}
+
+/*
+ * eval_mm_counters - Replay the trace with the counters running
+ */
+static void eval_mm_counters(trace_t *trace, int *fds, long long *counts)
+{
+#ifdef __linux__
+    char *msg;
+    int k;
+
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_counters");
+
+    for (k = 0; k < NCOUNTERS; k++)
+	if (fds[k] >= 0) {
+	    ioctl(fds[k], PERF_EVENT_IOC_RESET, 0);
+	    ioctl(fds[k], PERF_EVENT_IOC_ENABLE, 0);
+	}
+    msg = replay_trace(trace);
+    for (k = 0; k < NCOUNTERS; k++)
+	if (fds[k] >= 0)
+	    ioctl(fds[k], PERF_EVENT_IOC_DISABLE, 0);
+    if (msg != NULL)
+	app_error(msg);
+
+    for (k = 0; k < NCOUNTERS; k++)
+	if (fds[k] < 0 || 
+	    read(fds[k], &counts[k], sizeof(long long)) != sizeof(long long))
+	    counts[k] = 0;
+#endif
+}
+
+/*
+ * run_frag - Replay each trace, and every interval requests and at
+ *    the end of the trace, walk the heap and write its shape to a CSV
+ *    file, one row per sample. The rows show how fragmentation builds
+ *    up over a trace instead of only its peak utilization.
+ */
+static void run_frag(char **tracefiles, int num_tracefiles, 
+		     stats_t *mm_stats, int interval, char *filename)
+{
+    FILE *fp;
+    int i, b;
+    trace_t *trace;
+
+    if ((fp = fopen(filename, "w")) == NULL)
+	unix_error("fopen failed in run_frag");
+
+    fprintf(fp, "trace,op,heap_bytes,payload_bytes,alloc_bytes,free_bytes,"
+	    "free_blocks,largest_free,util,internal_frag,external_frag");
+    for (b = 0; b < FRAGBUCKETS; b++)
+	fprintf(fp, ",free_%ld%s", 1L << (b + FRAGMINSHIFT), 
+		(b == FRAGBUCKETS-1) ? "+" : "");
+    fprintf(fp, "\n");
+
+    for (i=0; i < num_tracefiles; i++) {
+	if (!mm_stats[i].valid)
+	    continue;
+	trace = read_trace(tracedir, tracefiles[i]);
+	eval_mm_frag(trace, tracefiles[i], interval, fp);
+	free_trace(trace);
+    }
+
+    fclose(fp);
+    printf("Heap fragmentation every %d requests written to %s\n\n", 
+	   interval, filename);
+}
+
+/*
+ * eval_mm_frag - Replay the trace, sampling the heap as we go
+ */
+static void eval_mm_frag(trace_t *trace, char *name, int interval, FILE *fp)
+{
+    int i, index, size;
+    char *p;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in eval_mm_frag");
+
+    /* A NULL block is not live, which sample_heap relies on */
+    memset(trace->blocks, 0, trace->num_ids * sizeof(char *));
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+
+        switch (trace->ops[i].type) {
+        case ALLOC: /* mm_malloc */
+	    if ((p = mm_malloc(size)) == NULL)
+		app_error("mm_malloc failed in eval_mm_frag");
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    if ((p = mm_realloc(trace->blocks[index], size)) == NULL)
+		app_error("mm_realloc failed in eval_mm_frag");
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+        case FREE: /* mm_free */
+	    mm_free(trace->blocks[index]);
+	    trace->blocks[index] = NULL;
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_frag");
+        }
+
+	if ((i + 1) % interval == 0 || i == trace->num_ops - 1)
+	    sample_heap(trace, name, i + 1, fp);
+    }
+}
+
+/*
+ * sample_heap - Walk the heap after opnum requests and write one CSV
+ *    row: the byte counts, then utilization (live payload over heap
+ *    size), internal fragmentation (the share of allocated block bytes
+ *    that is not payload), external fragmentation (1 - largest free
+ *    block over all free bytes), and the free block size histogram.
+ */
+static void sample_heap(trace_t *trace, char *name, int opnum, FILE *fp)
+{
+    char *lo = mem_heap_lo();
+    char *hi = mem_heap_hi();
+    long heapsize = mem_heapsize();
+    long payload = 0;
+    int i, b;
+
+    /* Blocks in mapped pages are not part of the walk, so leave
+       their payloads out as well */
+    for (i = 0; i < trace->num_ids; i++)
+	if (trace->blocks[i] != NULL && 
+	    trace->blocks[i] >= lo && trace->blocks[i] <= hi)
+	    payload += trace->block_sizes[i];
+
+    memset(&frag, 0, sizeof(frag));
+    mm_heapwalk(frag_visit);
+
+    fprintf(fp, "%s,%d,%ld,%ld,%ld,%ld,%ld,%ld,%.4f,%.4f,%.4f", 
+	    name, opnum, heapsize, payload, frag.alloc_bytes, 
+	    frag.free_bytes, frag.free_blocks, frag.largest_free,
+	    heapsize ? (double)payload / heapsize : 0.0,
+	    frag.alloc_bytes ? 1.0 - (double)payload / frag.alloc_bytes : 0.0,
+	    frag.free_bytes ? 
+	    1.0 - (double)frag.largest_free / frag.free_bytes : 0.0);
+    for (b = 0; b < FRAGBUCKETS; b++)
+	fprintf(fp, ",%ld", frag.hist[b]);
+    fprintf(fp, "\n");
+}
+
+/*
+ * frag_visit - Called by mm_heapwalk for each block in the heap
+ */
+static void frag_visit(void *bp, size_t size, int alloc)
+{
+    int b;
+
+    if (alloc) {
+	frag.alloc_bytes += size;
+	return;
+    }
+
+    frag.free_bytes += size;
+    frag.free_blocks++;
+    if ((long)size > frag.largest_free)
+	frag.largest_free = size;
+
+    /* The last bucket holds everything larger */
+    for (b = 0; b < FRAGBUCKETS-1 && size >= (2UL << (b + FRAGMINSHIFT)); b++)
+	;
+    frag.hist[b]++;
 }
 
 /*
@@ -1004,13 +1864,17 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValL] [-f <file>] [-t <dir>] [-p <n>] [-F <k> [-o <file>]]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-F <k>     Sample heap fragmentation every <k> requests.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Report request latencies and hardware counters.\n");
+    fprintf(stderr, "\t-o <file>  Write the -F samples to <file> (default frag.csv).\n");
+    fprintf(stderr, "\t-p <n>     Also replay traces on 1..<n> threads (mdriver-mt).\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
@@ -0,0 +1,545 @@
+/*
+ * mdtrace.c - An LD_PRELOAD shim that records the malloc, calloc,
+ *     realloc, and free calls of a running program and writes them out
+ *     as a tracefile in the format that mdriver reads.
+ *
+ *     unix> LD_PRELOAD=./mdtrace.so MDTRACE_FILE=proxy.rep ./proxy
+ *     unix> mdriver -V -f proxy.rep
+ *
+ * Addresses are remapped to dense block ids in allocation order, so
+ * the tracefile can be replayed against any allocator. The shim is
+ * configured through the environment:
+ *
+ *     MDTRACE_FILE     tracefile to write (default mdtrace-<pid>.rep)
+ *     MDTRACE_SAMPLE   record each allocation with probability 1/n;
+ *                      a block that is not sampled is ignored for its
+ *                      whole lifetime, including its reallocs
+ *     MDTRACE_MAX_OPS  stop after about n requests and write the file
+ *                      right away, which suits long running servers
+ *
+ * Blocks that are still allocated when the trace ends are freed at
+ * the end of the tracefile, and the suggested heap size in the header
+ * is the peak number of live payload bytes. Requests are spooled to
+ * <file>.ops while the program runs, since the header needs the final
+ * id and request counts.
+ *
+ * The shim calls the glibc __libc_* entry points directly, and a
+ * forked child stops recording so that it does not interleave its
+ * requests with those of its parent. The shim removes MDTRACE_FILE
+ * from the environment when it is loaded. A program that the traced
+ * process runs still inherits LD_PRELOAD and is traced too, but into
+ * its own mdtrace-<pid>.rep, so it cannot overwrite the parent's
+ * tracefile or spool. A process that replaces itself with exec never
+ * writes its tracefile and leaves its spool behind.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+#define BUFSIZE   65536   /* bytes of requests buffered before a write */
+#define MINSLOTS  65536   /* initial size of the address table */
+#define MAXPATH   4096
+
+/* Tracing states */
+#define UNINIT    0       /* environment not read yet */
+#define RECORDING 1       /* requests are being recorded */
+#define DONE      2       /* tracefile written, or tracing disabled */
+
+/* Maps the address of a live sampled block to its id and size */
+typedef struct {
+    void *ptr;            /* payload address, NULL if the slot is empty */
+    unsigned id;          /* block id in the tracefile */
+    unsigned size;        /* current payload size */
+} slot_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int busy;        /* set while this thread is in the shim */
+static int state = UNINIT;
+
+static char path[MAXPATH];       /* the tracefile */
+static char ops_path[MAXPATH+8]; /* where requests are spooled */
+static int ops_fd = -1;
+static char buf[BUFSIZE];
+static size_t buflen;
+
+static slot_t *slots;            /* open addressing, linear probing */
+static size_t nslots, nlive;
+
+static unsigned num_ids;         /* ids handed out so far */
+static unsigned num_ops;         /* requests recorded so far */
+static unsigned max_ops;         /* stop after this many, 0 if unlimited */
+static unsigned sample = 1;      /* record one in this many allocations */
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+static unsigned long live_bytes, peak_bytes;
+
+/* Hash of a payload address; the low bits are always zero */
+#define HASH(p) ((size_t)((((uintptr_t)(p) >> 4) * 0x9e3779b97f4a7c15ULL) >> 16))
+
+static int trace_begin(void);
+static void trace_end(void);
+static void trace_init(void);
+static void trace_finish(void);
+static void before_fork(void);
+static void parent_after_fork(void);
+static void child_after_fork(void);
+static void record_alloc(void *p, size_t size);
+static void record_free(void *p);
+static void record_realloc(void *oldp, void *newp, size_t size);
+static void emit(char type, unsigned id, unsigned size);
+static void flush_buf(void);
+static int sampled(void);
+static slot_t *table_find(void *p);
+static void table_insert(void *p, unsigned id, unsigned size);
+static void table_delete(slot_t *s);
+static void table_grow(void);
+
+/*********************************
+ * The intercepted malloc interface
+ *********************************/
+
+void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+
+    if (p != NULL && trace_begin()) {
+	record_alloc(p, size);
+	trace_end();
+    }
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p = __libc_calloc(nmemb, size);
+
+    /* calloc has already failed if nmemb * size overflows */
+    if (p != NULL && trace_begin()) {
+	record_alloc(p, nmemb * size);
+	trace_end();
+    }
+    return p;
+}
+
+/*
+ * realloc - The lock is held across the real realloc. Otherwise the old
+ *     block could be handed to another thread, and recorded as a new
+ *     allocation, before its old id was moved to the new address.
+ */
+void *realloc(void *ptr, size_t size)
+{
+    void *newp;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+    if (!trace_begin())
+	return __libc_realloc(ptr, size);
+    if ((newp = __libc_realloc(ptr, size)) != NULL)
+	record_realloc(ptr, newp, size);
+    trace_end();
+    return newp;
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL && trace_begin()) {
+	record_free(ptr);
+	trace_end();
+    }
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p = __libc_memalign(alignment, size);
+
+    if (p != NULL && trace_begin()) {
+	record_alloc(p, size);
+	trace_end();
+    }
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *p;
+
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+	return EINVAL;
+    if ((p = memalign(alignment, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+/*
+ * mdtrace_start - Read the environment as soon as the shim is loaded,
+ *     then hide MDTRACE_FILE from the programs that this one runs.
+ *     Nothing else runs yet, so changing the environment is safe here.
+ */
+__attribute__((constructor))
+static void mdtrace_start(void)
+{
+    busy = 1;
+    pthread_mutex_lock(&lock);
+    if (state == UNINIT)
+	trace_init();
+    pthread_mutex_unlock(&lock);
+    busy = 0;
+    unsetenv("MDTRACE_FILE");
+}
+
+/*
+ * mdtrace_fini - Write the tracefile when the program exits normally
+ */
+__attribute__((destructor))
+static void mdtrace_fini(void)
+{
+    busy = 1;
+    pthread_mutex_lock(&lock);
+    if (state == RECORDING)
+	trace_finish();
+    state = DONE;
+    pthread_mutex_unlock(&lock);
+    busy = 0;
+}
+
+/******************************************
+ * Entering and leaving the recording state
+ ******************************************/
+
+/*
+ * trace_begin - Take the lock and return 1 if the caller should record
+ *     its request. Memory that the shim itself allocates, for example
+ *     inside stdio, is not recorded, because busy is set by then.
+ */
+static int trace_begin(void)
+{
+    if (busy)
+	return 0;
+    busy = 1;
+    pthread_mutex_lock(&lock);
+    if (state == UNINIT)
+	trace_init();
+    if (state != RECORDING) {
+	pthread_mutex_unlock(&lock);
+	busy = 0;
+	return 0;
+    }
+    return 1;
+}
+
+/*
+ * trace_end - Write the tracefile if the request limit was reached,
+ *     and release the lock.
+ */
+static void trace_end(void)
+{
+    if (max_ops != 0 && num_ops >= max_ops)
+	trace_finish();
+    pthread_mutex_unlock(&lock);
+    busy = 0;
+}
+
+/*
+ * trace_init - Read the environment and open the request spool
+ */
+static void trace_init(void)
+{
+    char *s;
+
+    state = DONE;
+    if ((s = getenv("MDTRACE_FILE")) != NULL && s[0] != '\0')
+	snprintf(path, sizeof(path), "%s", s);
+    else
+	snprintf(path, sizeof(path), "mdtrace-%d.rep", (int)getpid());
+    snprintf(ops_path, sizeof(ops_path), "%s.ops", path);
+    if ((s = getenv("MDTRACE_SAMPLE")) != NULL && atoi(s) > 1)
+	sample = atoi(s);
+    if ((s = getenv("MDTRACE_MAX_OPS")) != NULL && atoi(s) > 0)
+	max_ops = atoi(s);
+
+    if ((ops_fd = open(ops_path, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644)) < 0) {
+	fprintf(stderr, "mdtrace: could not open %s\n", ops_path);
+	return;
+    }
+    nslots = MINSLOTS;
+    if ((slots = __libc_calloc(nslots, sizeof(slot_t))) == NULL) {
+	close(ops_fd);
+	return;
+    }
+    rng ^= (uint64_t)getpid();
+    pthread_atfork(before_fork, parent_after_fork, child_after_fork);
+    state = RECORDING;
+}
+
+/*
+ * before_fork - Hold the lock across fork, so that no other thread is
+ *     inside the shim when the child's copy of the lock is made.
+ */
+static void before_fork(void)
+{
+    busy = 1;
+    pthread_mutex_lock(&lock);
+}
+
+static void parent_after_fork(void)
+{
+    pthread_mutex_unlock(&lock);
+    busy = 0;
+}
+
+/*
+ * child_after_fork - The child shares the spool with its parent, so
+ *     it must not record anything. Its lock is a copy of one that was
+ *     held, so it starts over with a fresh one.
+ */
+static void child_after_fork(void)
+{
+    pthread_mutex_init(&lock, NULL);
+    state = DONE;
+    busy = 0;
+}
+
+/*
+ * trace_finish - Free the blocks that are still live, then write the
+ *     tracefile: the header followed by the spooled requests.
+ */
+static void trace_finish(void)
+{
+    FILE *fp;
+    size_t i;
+    ssize_t n;
+    char copybuf[BUFSIZE];
+    int fd;
+
+    state = DONE;
+    for (i = 0; i < nslots; i++)
+	if (slots[i].ptr != NULL)
+	    emit('f', slots[i].id, 0);
+    flush_buf();
+    close(ops_fd);
+
+    if ((fp = fopen(path, "w")) == NULL) {
+	fprintf(stderr, "mdtrace: could not open %s\n", path);
+	return;
+    }
+    fprintf(fp, "%lu\n%u\n%u\n%d\n", peak_bytes, num_ids, num_ops, 1);
+    if ((fd = open(ops_path, O_RDONLY)) >= 0) {
+	fflush(fp);
+	while ((n = read(fd, copybuf, sizeof(copybuf))) > 0)
+	    fwrite(copybuf, 1, n, fp);
+	close(fd);
+	unlink(ops_path);
+    }
+    fclose(fp);
+    fprintf(stderr, "mdtrace: wrote %u requests on %u blocks to %s\n",
+	    num_ops, num_ids, path);
+}
+
+/*****************************************
+ * Turning requests into tracefile records
+ *****************************************/
+
+/*
+ * record_alloc - Give a sampled new block the next id. mdriver requires
+ *     positive sizes, so a zero-byte request is recorded as one byte.
+ */
+static void record_alloc(void *p, size_t size)
+{
+    unsigned id;
+
+    if (size > INT_MAX || !sampled())
+	return;
+    if (size == 0)
+	size = 1;
+    id = num_ids++;
+    table_insert(p, id, size);
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+    emit('a', id, size);
+}
+
+/*
+ * record_free - Free the block at p, unless it was never sampled
+ */
+static void record_free(void *p)
+{
+    slot_t *s;
+
+    if ((s = table_find(p)) == NULL)
+	return;
+    live_bytes -= s->size;
+    emit('f', s->id, 0);
+    table_delete(s);
+}
+
+/*
+ * record_realloc - Move a sampled block from oldp to newp, keeping its id.
+ *     If the new size is too large to record, the block is recorded as
+ *     freed and is not followed any further.
+ */
+static void record_realloc(void *oldp, void *newp, size_t size)
+{
+    slot_t *s;
+    unsigned id;
+
+    if ((s = table_find(oldp)) == NULL)
+	return;
+    id = s->id;
+    live_bytes -= s->size;
+    table_delete(s);
+    if (size > INT_MAX) {
+	emit('f', id, 0);
+	return;
+    }
+    table_insert(newp, id, size);
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+    emit('r', id, size);
+}
+
+/*
+ * emit - Append one request to the spool
+ */
+static void emit(char type, unsigned id, unsigned size)
+{
+    if (buflen > BUFSIZE - 32)
+	flush_buf();
+    if (type == 'f')
+	buflen += snprintf(buf + buflen, BUFSIZE - buflen, "f %u\n", id);
+    else
+	buflen += snprintf(buf + buflen, BUFSIZE - buflen, "%c %u %u\n",
+			   type, id, size);
+    num_ops++;
+}
+
+static void flush_buf(void)
+{
+    size_t off = 0;
+    ssize_t n;
+
+    while (off < buflen) {
+	if ((n = write(ops_fd, buf + off, buflen - off)) <= 0)
+	    break;
+	off += n;
+    }
+    buflen = 0;
+}
+
+/*
+ * sampled - Decide whether to record a new block (xorshift64)
+ */
+static int sampled(void)
+{
+    if (sample <= 1)
+	return 1;
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng % sample == 0;
+}
+
+/***********************************************
+ * The address table: payload address -> block id
+ ***********************************************/
+
+static slot_t *table_find(void *p)
+{
+    size_t mask = nslots - 1;
+    size_t i;
+
+    for (i = HASH(p) & mask; slots[i].ptr != NULL; i = (i + 1) & mask)
+	if (slots[i].ptr == p)
+	    return &slots[i];
+    return NULL;
+}
+
+static void table_insert(void *p, unsigned id, unsigned size)
+{
+    size_t mask, i;
+
+    if (2 * (nlive + 1) > nslots)
+	table_grow();
+    mask = nslots - 1;
+    for (i = HASH(p) & mask; slots[i].ptr != NULL; i = (i + 1) & mask)
+	;
+    slots[i].ptr = p;
+    slots[i].id = id;
+    slots[i].size = size;
+    nlive++;
+}
+
+/*
+ * table_delete - Empty slot s, shifting later entries of its probe
+ *     run back so that lookups never need tombstones.
+ */
+static void table_delete(slot_t *s)
+{
+    size_t mask = nslots - 1;
+    size_t i = s - slots;
+    size_t j = i;
+    size_t k;
+
+    for (;;) {
+	j = (j + 1) & mask;
+	if (slots[j].ptr == NULL)
+	    break;
+	/* The entry at j may move to i unless its home k lies in (i, j] */
+	k = HASH(slots[j].ptr) & mask;
+	if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+	    continue;
+	slots[i] = slots[j];
+	i = j;
+    }
+    slots[i].ptr = NULL;
+    nlive--;
+}
+
+/*
+ * table_grow - Double the table. If there is no memory for that, the
+ *     old table is used until it is completely full.
+ */
+static void table_grow(void)
+{
+    slot_t *old = slots;
+    size_t oldn = nslots;
+    size_t i;
+
+    if ((slots = __libc_calloc(2 * oldn, sizeof(slot_t))) == NULL) {
+	slots = old;
+	if (nlive + 1 < nslots)
+	    return;
+	fprintf(stderr, "mdtrace: out of memory for the address table\n");
+	abort();
+    }
+    nslots = 2 * oldn;
+    nlive = 0;
+    for (i = 0; i < oldn; i++)
+	if (old[i].ptr != NULL)
+	    table_insert(old[i].ptr, old[i].id, old[i].size);
+    __libc_free(old);
+}
@@ -2,7 +2,14 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ *            Besides the sbrk heap, the model hands out page mappings
+ *            (mem_map), which are real mmap regions that go back to the
+ *            system when they are unmapped. The footprint of the package
+ *            is the heap plus the mapped pages, and mem_peak_heapsize
+ *            reports its high-water mark.
  */
+#define _GNU_SOURCE  /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -10,6 +17,7 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "memlib.h"
 #include "config.h"
@@ -19,6 +27,21 @@ static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
 
+/* Records one live page mapping */
+typedef struct mapping_t {
+    char *addr;                /* first byte of the mapping */
+    size_t size;               /* length in bytes, a multiple of the page size */
+    struct mapping_t *next;    /* next live mapping */
+} mapping_t;
+
+static mapping_t *mappings;  /* all live mappings */
+static size_t mem_mapped;    /* bytes in live mappings */
+static size_t mem_peak;      /* largest heap + mapped bytes since the reset */
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t page_round(size_t size);
+static void update_peak(void);
+
 /* 
  * mem_init - initialize the memory system model
  */
@@ -39,35 +62,167 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
+    mem_reset_brk();
     free(mem_start_brk);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    and unmap every page mapping that is still live
  */
 void mem_reset_brk()
 {
+    mapping_t *m;
+
+    pthread_mutex_lock(&mem_lock);
+    while ((m = mappings) != NULL) {
+	mappings = m->next;
+	munmap(m->addr, m->size);
+	free(m);
+    }
+    mem_mapped = 0;
     mem_brk = mem_start_brk;
+    mem_peak = 0;
+    pthread_mutex_unlock(&mem_lock);
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. 
+ *    A negative incr shrinks the heap, and the whole pages past the
+ *    new brk are given back to the system.
  */
 void *mem_sbrk(int incr) 
 {
     char *old_brk = mem_brk;
+    char *lo;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if (((mem_brk + incr) > mem_max_addr) || 
+	((mem_brk + incr) < mem_start_brk)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
+
+    pthread_mutex_lock(&mem_lock);
     mem_brk += incr;
+    if (incr < 0) {
+	lo = (char *)page_round((size_t)mem_brk);
+	if (lo < old_brk)
+	    madvise(lo, old_brk - lo, MADV_DONTNEED);
+    }
+    update_peak();
+    pthread_mutex_unlock(&mem_lock);
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - map at least size bytes of fresh zeroed pages outside the
+ *    heap, and return their address, or (void *)-1 if the model's
+ *    limit of MAX_HEAP mapped bytes or the system refuses
+ */
+void *mem_map(size_t size)
+{
+    mapping_t *m;
+    char *addr;
+
+    size = page_round(size);
+    if ((m = (mapping_t *)malloc(sizeof(mapping_t))) == NULL) {
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+
+    pthread_mutex_lock(&mem_lock);
+    if (mem_mapped + size > MAX_HEAP ||
+	(addr = mmap(NULL, size, PROT_READ|PROT_WRITE, 
+		     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+	pthread_mutex_unlock(&mem_lock);
+	free(m);
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    m->addr = addr;
+    m->size = size;
+    m->next = mappings;
+    mappings = m;
+    mem_mapped += size;
+    update_peak();
+    pthread_mutex_unlock(&mem_lock);
+    return (void *)addr;
+}
+
+/*
+ * mem_remap - resize the mapping at addr to at least size bytes, moving
+ *    it if it cannot grow in place. Returns the new address, or 
+ *    (void *)-1 with the old mapping left intact.
+ */
+void *mem_remap(void *addr, size_t size)
+{
+    mapping_t *m;
+    char *newaddr;
+
+    size = page_round(size);
+    pthread_mutex_lock(&mem_lock);
+    for (m = mappings; m != NULL && m->addr != addr; m = m->next)
+	;
+    if (m == NULL || mem_mapped - m->size + size > MAX_HEAP ||
+	(newaddr = mremap(m->addr, m->size, size, MREMAP_MAYMOVE)) == MAP_FAILED) {
+	pthread_mutex_unlock(&mem_lock);
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    mem_mapped = mem_mapped - m->size + size;
+    m->addr = newaddr;
+    m->size = size;
+    update_peak();
+    pthread_mutex_unlock(&mem_lock);
+    return (void *)newaddr;
+}
+
+/*
+ * mem_unmap - give the mapping at addr back to the system
+ */
+int mem_unmap(void *addr)
+{
+    mapping_t *m;
+    mapping_t **prevpp;
+
+    pthread_mutex_lock(&mem_lock);
+    for (prevpp = &mappings; (m = *prevpp) != NULL; prevpp = &m->next) {
+	if (m->addr == addr) {
+	    *prevpp = m->next;
+	    mem_mapped -= m->size;
+	    pthread_mutex_unlock(&mem_lock);
+	    munmap(m->addr, m->size);
+	    free(m);
+	    return 0;
+	}
+    }
+    pthread_mutex_unlock(&mem_lock);
+    errno = EINVAL;
+    return -1;
+}
+
+/*
+ * mem_is_mapped - return true if the bytes lo..hi all lie in one live
+ *    mapping
+ */
+int mem_is_mapped(void *lo, void *hi)
+{
+    mapping_t *m;
+    int found = 0;
+
+    pthread_mutex_lock(&mem_lock);
+    for (m = mappings; m != NULL; m = m->next) {
+	if ((char *)lo >= m->addr && (char *)hi < m->addr + m->size) {
+	    found = 1;
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&mem_lock);
+    return found;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -92,6 +247,23 @@ size_t mem_heapsize()
     return (size_t)(mem_brk - mem_start_brk);
 }
 
+/*
+ * mem_mapsize() - returns the number of bytes in live page mappings
+ */
+size_t mem_mapsize()
+{
+    return mem_mapped;
+}
+
+/*
+ * mem_peak_heapsize() - returns the largest heap size plus mapped bytes
+ *    seen since the last mem_reset_brk
+ */
+size_t mem_peak_heapsize()
+{
+    return mem_peak;
+}
+
 /*
  * mem_pagesize() - returns the page size of the system
  */
@@ -99,3 +271,25 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * page_round - round size up to a multiple of the page size
+ */
+static size_t page_round(size_t size)
+{
+    size_t pagesize = mem_pagesize();
+
+    return (size + pagesize - 1) & ~(pagesize - 1);
+}
+
+/*
+ * update_peak - fold the current footprint into the high-water mark;
+ *    the caller holds mem_lock
+ */
+static void update_peak(void)
+{
+    size_t size = (size_t)(mem_brk - mem_start_brk) + mem_mapped;
+
+    if (size > mem_peak)
+	mem_peak = size;
+}
@@ -9,3 +9,10 @@ void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
+void *mem_map(size_t size);
+void *mem_remap(void *addr, size_t size);
+int mem_unmap(void *addr);
+int mem_is_mapped(void *lo, void *hi);
+size_t mem_mapsize(void);
+size_t mem_peak_heapsize(void);
+
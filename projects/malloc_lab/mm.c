@@ -9,8 +9,12 @@
  * NOTE TO STUDENTS: Replace this header comment with your own header
  * comment that gives a high level description of your solution.
  * 
- * Seglist
- * Perf index = 45 (util) + 40 (thru) = 85/100
+ * Seglist + RB tree (large bin) + fast bin (deferred coalescing)
+ * 64바이트 이하는 slab (페이지 하나를 같은 크기 객체로 나누고 비트맵으로 관리)
+ * 128KB 이상은 mmap 블록, 힙 끝이 크게 비면 trim
+ * Perf index = 56 (util) + 40 (thru) = 96/100
+ *
+ * -DMM_THREADS: 아레나 락 + 스레드별 캐시 (make mdriver-mt)
  */
 
 #include <stdio.h>
@@ -18,6 +22,9 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -47,10 +54,53 @@ team_t team = {
 #define CHUNKSIZE (1<<12)
 #define INITCHUNKSIZE (1<<6)
 
-// 가용 연결 리스트의 개수 (최대값)
-#define LISTLIMIT 20
+// 가용 리스트(bin) 구성
+// 1) small bin: 256바이트 미만 블록은 8바이트 단위로 크기가 정확히 같은 블록끼리 모음 (index = size / 8)
+// 2) large bin: 256바이트 이상 블록은 2의 거듭제곱 구간별로 모음 [2^k, 2^(k+1))
+//    large bin 하나는 (크기, 주소) 순서의 RB 트리, 노드는 가용 블록 자체에 저장
+#define SMALLBIN_SHIFT 8
+#define SMALLBIN_LIMIT (1<<SMALLBIN_SHIFT)
+#define NSMALLBINS (SMALLBIN_LIMIT / DSIZE)
+#define NLARGEBINS (32 - SMALLBIN_SHIFT)
+#define NBINS (NSMALLBINS + NLARGEBINS)
+
+// fast bin: 256바이트 미만 블록은 해제해도 통합하지 않고 크기별 LIFO 리스트에 보관
+// SLAB_MAX 이하 요청은 slab이 맡으므로 실제로 fast bin에 들어가는 블록은 80바이트 이상
+// fast bin의 블록은 할당 상태로 남아있어 이웃 블록의 coalesce 대상이 되지 않음
+// 맞는 블록이 없거나 보관한 블록이 FASTBIN_MAX개가 되면 한꺼번에 통합 (consolidate)
+#define FASTBIN_LIMIT 256
+#define NFASTBINS (FASTBIN_LIMIT / DSIZE)
+#define FASTBIN_MAX 64
+// mm_heapwalk가 fast bin의 블록을 가용 블록으로 보고하기 위해 잠시 켜는 H 비트
+#define FASTBIN_MARK 0x4
+
+// mmap 블록: MMAP_THRESHOLD 이상인 블록은 힙 밖의 페이지 매핑에서 바로 할당하고, free하면 시스템에 반환
+// 매핑의 첫 워드는 패딩, 그다음 헤더에 매핑 전체 크기와 MAPPED 비트를 기록 (payload는 8바이트 정렬)
+#define MMAP_THRESHOLD (1<<17)
+#define MAPPED 0x2
+
+// 힙 끝의 가용 블록이 TRIM_THRESHOLD 이상이면 TRIM_PAD만 남기고 힙을 줄임
+// 1) TRIM_CHECK 이상인 큰 블록을 free해서 그렇게 됐을 때는 바로 줄임
+// 2) 작은 블록들이 쌓여 그렇게 됐을 때는 그 상태로 free가 TRIM_DELAY번 이어져야 줄임
+//    반환한 페이지는 다시 쓸 때 page fault가 나므로 잠깐 비었다 다시 커지는 힙은 줄이지 않음
+#define TRIM_THRESHOLD (1<<17)
+#define TRIM_PAD (1<<16)
+#define TRIM_CHECK (1<<16)
+#define TRIM_DELAY 4096
+
+// slab: SLAB_MAX 이하 요청은 H, F 없는 같은 크기 객체로 할당 (객체 크기 8, 16, ..., 64)
+// slab 하나는 payload가 페이지 경계에서 시작하는 SLAB_SIZE 크기의 힙 블록 (F와 다음 H가 페이지 끝 8바이트)
+// 블록 크기가 페이지 크기와 같으므로 slab끼리 빈틈 없이 이어질 수 있음
+// 페이지 맨 앞의 slab 헤더: 링크 2워드, 객체 크기, 남은 객체 수, 객체별 할당 비트맵
+// 주소가 slab 객체인지는 페이지 번호로 slab_map을 보고, 객체 크기는 그 페이지의 slab 헤더에서 읽음
+#define SLAB_SHIFT 12
+#define SLAB_SIZE (1<<SLAB_SHIFT)
+#define SLAB_MAX 64
+#define NSLABCLASSES (SLAB_MAX / DSIZE)
+#define SLAB_HDRSIZE (4*WSIZE + SLAB_SIZE/DSIZE/8)
 
 #define MAX(x,y) ((x)>(y) ? (x) : (y))
+#define MIN(x,y) ((x)<(y) ? (x) : (y))
 
 // size: 블록 사이즈, alloc: 가용 여부 => 둘이 합치면 온전한 주소
 #define PACK(size,alloc) ((size)|(alloc))
@@ -64,6 +114,8 @@ team_t team = {
 #define GET_SIZE(p) (GET(p) & ~0X7)
 // 마지막 비트 1개 값 => 가용 여부
 #define GET_ALLOC(p) (GET(p) & 0X1)
+// 두 번째 비트 => 페이지 매핑에서 할당한 블록인지
+#define GET_MAPPED(p) (GET(p) & MAPPED)
 
 // WSIZE를 빼는 이유: bp는 항상 payload의 시작점, bp에서 1워드만큼 앞으로 이동
 #define HDRP(bp) ((char*)(bp) - WSIZE)
@@ -73,43 +125,261 @@ team_t team = {
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-// P가 가르키는 곳을 PTR로 변경
-#define SET_PTR(p, ptr) (*(unsigned int *)(p) = (unsigned int)(ptr))
+// 가용 블록의 링크는 힙 시작 주소로부터의 오프셋(1워드)으로 저장, 0은 NULL
+// 포인터 크기와 상관없이 최소 블록(2*DSIZE) 안에 링크 두 개가 들어감
+#define GET_LINK(p) (GET(p) ? heap_base + GET(p) : NULL)
+#define SET_PTR(p, ptr) PUT(p, (ptr) ? (unsigned int)((char *)(ptr) - heap_base) : 0)
 
 // 가용 블럭 리스트에서 이전, 이후 블록 포인터를 반환
 #define NEXT_PTR(ptr) ((char *)(ptr))
 #define PREV_PTR(ptr) ((char *)(ptr) + WSIZE)
 
 // 분리되어 있는 가용 리스트 내에서 이전, 이후 블록 포인터를 반환
-#define NEXT(ptr) (*(char **)(ptr))
-#define PREV(ptr) (*(char **)(PREV_PTR(ptr)))
+#define NEXT(ptr) GET_LINK(NEXT_PTR(ptr))
+#define PREV(ptr) GET_LINK(PREV_PTR(ptr))
+
+// large bin 트리 노드: payload 앞 4워드에 왼쪽/오른쪽/부모 링크와 색을 저장
+#define LEFT_PTR(bp) ((char *)(bp))
+#define RIGHT_PTR(bp) ((char *)(bp) + WSIZE)
+#define PARENT_PTR(bp) ((char *)(bp) + (2*WSIZE))
+#define COLOR_PTR(bp) ((char *)(bp) + (3*WSIZE))
+
+// 트리 링크는 비어있을 때도 Nil 노드를 가리키므로 NULL 검사가 필요 없음
+#define GET_NODE(p) (heap_base + GET(p))
+#define SET_NODE(p, bp) PUT(p, (unsigned int)((char *)(bp) - heap_base))
+
+#define LEFT(bp) GET_NODE(LEFT_PTR(bp))
+#define RIGHT(bp) GET_NODE(RIGHT_PTR(bp))
+#define PARENT(bp) GET_NODE(PARENT_PTR(bp))
+#define COLOR(bp) GET(COLOR_PTR(bp))
+
+#define RED 0
+#define BLACK 1
+
+// 트리 Nil 노드의 크기 (링크 3개 + 색)
+#define TREE_NODE_SIZE (4*WSIZE)
+
+// slab 헤더 필드, 링크는 가용 블록과 같은 NEXT_PTR/PREV_PTR 자리에 오프셋으로 저장
+#define SLAB_OBJSIZE(s) ((char *)(s) + (2*WSIZE))
+#define SLAB_NFREE(s) ((char *)(s) + (3*WSIZE))
+#define SLAB_BITMAP(s) ((unsigned long long *)((char *)(s) + (4*WSIZE)))
+
+// 요청 크기에 맞는 slab 번호, 객체가 속한 slab, 객체 크기별 slab 하나의 객체 수
+#define SLAB_CLASS(size) (((size) - 1) >> 3)
+#define SLAB_OF(bp) ((char *)((unsigned long)(bp) & ~(unsigned long)(SLAB_SIZE - 1)))
+#define SLAB_NOBJS(objsize) ((SLAB_SIZE - DSIZE - SLAB_HDRSIZE) / (objsize))
+
+// 힙 시작 주소가 속한 페이지부터 센 페이지 번호
+#define PAGE_INDEX(bp) (((unsigned long)(bp) >> SLAB_SHIFT) - ((unsigned long)heap_base >> SLAB_SHIFT))
+
+// 멀티스레드 빌드 (-DMM_THREADS)
+// 1) 아레나마다 락을 두고, 256바이트 미만 블록은 스레드별 캐시(tcache)에서 락 없이 처리
+// 2) -DMM_NARENAS=N 이면 스레드마다 N개 아레나 중 하나를 돌아가며 배정
+#ifndef MM_NARENAS
+#define MM_NARENAS 1
+#endif
+
+#if MM_NARENAS > 1 && !defined(MM_THREADS)
+#error "MM_NARENAS > 1 requires MM_THREADS"
+#endif
+
+#ifdef MM_THREADS
+#define MM_TLS __thread
+#else
+#define MM_TLS
+#endif
+
+#define CACHELINE 64
+
+// 스레드 캐시 bin당 최대 블록 수, 중앙 힙에서 한 번에 채우고 반납하는 블록 수
+#define TCACHE_MAX 32
+#define TCACHE_BATCH 16
+
+// 아레나가 여러 개일 때 힙을 2^12 바이트 단위로 나눠 어느 아레나 소유인지 기록
+// 아레나의 새 세그먼트는 항상 이 단위의 경계에서 시작함
+#define ARENA_MAP_SHIFT 12
+#define ARENA_MAP_SIZE (1<<16)
+#define ARENA_SEGMENT (1<<16)
+
+// 아레나: 가용 리스트, bin 비트맵, 트리 Nil 노드를 각자 가짐
+// 캐시 라인 단위로 정렬해 다른 아레나의 락과 false sharing이 생기지 않도록 함
+typedef struct {
+    void *free_list[NBINS];
+    // 비어있지 않은 bin을 비트로 표시, 다음으로 쓸 수 있는 bin을 한 번에 찾기 위해
+    unsigned long long binmap;
+    // large bin 트리가 공유하는 Nil 노드, 링크가 오프셋이므로 힙 안(패딩 바로 뒤)에 둠
+    char *nil;
+    // 이 아레나의 마지막 세그먼트의 에필로그 헤더
+    char *top;
+    // 통합을 미룬 작은 블록들 (index = size / 8), 보관 중인 블록 수
+    char *fastbins[NFASTBINS];
+    int fastcount;
+    // 객체 크기별로 빈 객체가 남아있는 slab 리스트
+    char *slabs[NSLABCLASSES];
+    // 힙 끝 가용 블록이 TRIM_THRESHOLD 이상인 채로 이어진 free 횟수
+    int trim_wait;
+#ifdef MM_THREADS
+    pthread_mutex_t lock;
+#endif
+} __attribute__((aligned(CACHELINE))) arena_t;
 
 // Jiwon Parameter & Function
 char *heap_listp = 0;
-void *free_list[LISTLIMIT];
+static char *heap_base;
+static arena_t arenas[MM_NARENAS];
+
+// 현재 스레드가 잠그고 사용 중인 아레나, 내부 함수는 모두 av를 대상으로 동작
+static MM_TLS arena_t *av;
+
+// 페이지마다 slab 페이지인지 표시, 바이트 단위라 다른 아레나와 같은 워드를 고쳐 쓰지 않음
+static unsigned char slab_map[ARENA_MAP_SIZE];
+
+#if MM_NARENAS > 1
+static unsigned char arena_map[ARENA_MAP_SIZE];
+static pthread_mutex_t sbrk_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int next_arena;
+static MM_TLS arena_t *thread_arena;
+
+#define ARENA_OF(bp) (&arenas[arena_map[((char *)(bp) - heap_base) >> ARENA_MAP_SHIFT]])
+#else
+#define ARENA_OF(bp) (&arenas[0])
+#endif
+
+#ifdef MM_THREADS
+// 스레드 캐시: small bin과 같은 번호로 크기별 LIFO 리스트를 가지고, 그 뒤에 slab 객체 크기별 리스트
+// 캐시 안의 블록은 힙에서 할당 상태로 남아있어 coalesce 대상이 되지 않음 (slab 객체도 비트가 켜진 채)
+#define TCACHE_BINS (NSMALLBINS + NSLABCLASSES)
+
+typedef struct {
+    char *bins[TCACHE_BINS];
+    int counts[TCACHE_BINS];
+    unsigned int epoch;
+} tcache_t;
+
+static MM_TLS tcache_t tcache;
+
+// mm_init마다 증가, 이전 힙에서 채운 캐시를 버리기 위해
+static unsigned int heap_epoch;
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+
+static void *tcache_malloc(int class, size_t asize);
+static void tcache_free(void *ptr, int class);
+static void tcache_drain(int class, int n);
+#endif
+
+static arena_t *get_arena(void);
+static void arena_lock(arena_t *a);
+static void arena_unlock(void);
+static void *arena_malloc(size_t asize);
+static void arena_free(void *ptr);
+
+static void walk_block(char *bp, void (*visit)(void *bp, size_t size, int alloc));
+static int resize_in_place(void *bp, size_t asize);
+static void *mmap_malloc(size_t asize);
+static void *mmap_realloc(void *ptr, size_t size);
+
+static void *slab_malloc(int class);
+static void slab_free(void *bp);
+static char *slab_new(size_t objsize);
+static void slab_link(int class, char *slab);
+static void slab_unlink(int class, char *slab);
 
 static void *coalesce(void *bp);
+static void consolidate(void);
 static void *extend_heap(size_t words);
+static void maybe_trim(void);
+static void trim_heap(void *bp);
+static int arena_at_top(void);
+#if MM_NARENAS > 1
+static void map_arena(char *bp, size_t size);
+static void *new_segment(size_t size);
+#endif
 static void *find_fit(size_t asize);
 static void place(void *bp, size_t asize);
+static void shrink_block(void *bp, size_t asize);
 static void insert_block(void *ptr, size_t size);
 static void delete_block(void *ptr);
 
+static void tree_insert(void **root, char *z);
+static void tree_delete(void **root, char *z);
+static char *tree_best_fit(void *root, size_t asize);
+static void tree_left_rotate(void **root, char *x);
+static void tree_right_rotate(void **root, char *x);
+static void tree_transplant(void **root, char *u, char *v);
+
+// 블록 사이즈에 해당하는 bin 번호, 반복문 없이 clz로 구간을 계산
+static inline int bin_index(size_t size) {
+    if (size < SMALLBIN_LIMIT) {
+        return size >> 3;
+    }
+
+    return NSMALLBINS + (31 - __builtin_clz((unsigned int)size)) - SMALLBIN_SHIFT;
+}
+
+// 오버헤드, 정렬 사항 생각해서 요청 사이즈를 블록 사이즈로 조정
+static inline size_t adjust_size(size_t size) {
+    // H, F 포함하여 블록 사이즈를 조정해야 함으로
+    if (size <= DSIZE) {
+        return DSIZE * 2;
+    }
+
+    // DSIZE보다 클 때는 블록이 가질 수 있는 크기 중 최적화된 크기로 재조정
+    // (DSIZE-1)는 8의 배수로 만들어주기 위한 코드, int 연산은 소수점 버림
+    return DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
+}
+
+// slab 객체인지: 힙 밖(mmap 블록)이거나 slab 페이지가 아니면 H가 있는 블록
+static inline int is_slab(void *bp) {
+    unsigned long page = PAGE_INDEX(bp);
+
+    return page < ARENA_MAP_SIZE && slab_map[page];
+}
+
 /* 
  * mm_init - initialize the malloc package.
  */
 int mm_init(void) {
-    // 전체 free list 초기화 단계
-    for (int class = 0; class < LISTLIMIT; class++) {
-        free_list[class] = NULL;
-    }
-    
-    if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1) {
+    char *nil;
+
+    if ((heap_listp = mem_sbrk(4*WSIZE + MM_NARENAS*TREE_NODE_SIZE)) == (void *)-1) {
         return -1;
     }
-    
-    // 패딩(0), 프롤로그 H/F(1), 에필로그 H 생성(0)
+    heap_base = heap_listp;
+
+    // 패딩(0), 아레나별 트리 Nil 노드(BLACK), 프롤로그 H/F(1), 에필로그 H 생성(0)
     PUT(heap_listp, 0);
+    heap_listp += WSIZE;
+
+    // 전체 free list 초기화 단계: small bin은 NULL, large bin은 빈 트리(Nil)
+    for (int i = 0; i < MM_NARENAS; i++) {
+        nil = heap_listp;
+        SET_NODE(LEFT_PTR(nil), nil);
+        SET_NODE(RIGHT_PTR(nil), nil);
+        SET_NODE(PARENT_PTR(nil), nil);
+        PUT(COLOR_PTR(nil), BLACK);
+        heap_listp += TREE_NODE_SIZE;
+
+        for (int class = 0; class < NBINS; class++) {
+            arenas[i].free_list[class] = (class < NSMALLBINS) ? NULL : nil;
+        }
+        for (int class = 0; class < NFASTBINS; class++) {
+            arenas[i].fastbins[class] = NULL;
+        }
+        arenas[i].fastcount = 0;
+        for (int class = 0; class < NSLABCLASSES; class++) {
+            arenas[i].slabs[class] = NULL;
+        }
+        arenas[i].trim_wait = 0;
+        arenas[i].binmap = 0;
+        arenas[i].nil = nil;
+        arenas[i].top = NULL;
+#ifdef MM_THREADS
+        pthread_mutex_init(&arenas[i].lock, NULL);
+#endif
+    }
+    heap_listp -= WSIZE;
+
     PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (3*WSIZE), PACK(0, 1));
@@ -117,6 +387,17 @@ int mm_init(void) {
     // 프롤로그 F로 위치, 앞이나 뒤 블록으로 가기 위해
     heap_listp += (2*WSIZE);
 
+    // 첫 세그먼트는 0번 아레나 소유
+    av = &arenas[0];
+    av->top = heap_listp + WSIZE;
+    memset(slab_map, 0, sizeof(slab_map));
+#if MM_NARENAS > 1
+    memset(arena_map, 0, sizeof(arena_map));
+#endif
+#ifdef MM_THREADS
+    heap_epoch++;
+#endif
+
     // extend_heap 함수는 워드 단위임
     if (extend_heap(INITCHUNKSIZE) == NULL) {
         return -1;
@@ -131,38 +412,45 @@ int mm_init(void) {
  */
 void *mm_malloc(size_t size) {
     // asize: 블록 사이즈 조정
-    // extendsize: 적당한 곳이 없으면 확장해야 함, 확장할 사이즈 저장
     size_t asize;
-    size_t extendsize;
     char *bp;
 
     if (size == 0) {
         return NULL;
     }
 
-    // 오버헤드, 정렬 사항 생각해서 블록 사이즈를 조정
-    if (size <= DSIZE) {
-        // H, F 포함하여 블록 사이즈를 조정해야 함으로
-        asize = DSIZE * 2;
-    } else {
-        // DSIZE보다 클 때는 블록이 가질 수 있는 크기 중 최적화된 크기로 재조정
-        // (DSIZE-1)는 8의 배수로 만들어주기 위한 코드, int 연산은 소수점 버림
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
+    // 작은 요청은 slab 객체로 할당, slab을 만들지 못하면 힙 블록으로 할당
+    if (size <= SLAB_MAX) {
+#ifdef MM_THREADS
+        bp = tcache_malloc(NSMALLBINS + SLAB_CLASS(size), 0);
+#else
+        arena_lock(get_arena());
+        bp = slab_malloc(SLAB_CLASS(size));
+        arena_unlock();
+#endif
+        if (bp != NULL) {
+            return bp;
+        }
     }
-    
-    // 가용 블록 검색 후 요청한 블록 배치 (검색 -> 배치)
-    if ((bp = find_fit(asize)) != NULL) {
-        place(bp, asize);
+
+    // 오버헤드, 정렬 사항 생각해서 블록 사이즈를 조정
+    asize = adjust_size(size);
+
+    // 큰 블록은 페이지 매핑에서 할당, 매핑에 실패하면 힙에서 할당
+    if (asize >= MMAP_THRESHOLD && (bp = mmap_malloc(asize)) != NULL) {
         return bp;
     }
 
-    // 알맞은 가용 블록이 없을 경우 확장 후 블록 배치 (검색 -> 확장 -> 배치)
-    extendsize = MAX(asize, CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
-        return NULL;
+#ifdef MM_THREADS
+    // 작은 블록은 스레드 캐시에서 락 없이 처리
+    if (asize < SMALLBIN_LIMIT) {
+        return tcache_malloc(asize >> 3, asize);
     }
+#endif
 
-    place(bp, asize);
+    arena_lock(get_arena());
+    bp = arena_malloc(asize);
+    arena_unlock();
 
     return bp;
 }
@@ -172,31 +460,97 @@ void *mm_malloc(size_t size) {
  */
 // 블록을 반환하고 인접 가용 블록들과 통합 (통합은 coalesce에서 수행)
 void mm_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    // slab 객체는 H가 없으므로 H를 읽기 전에 페이지로 구분
+    if (is_slab(ptr)) {
+#ifdef MM_THREADS
+        tcache_free(ptr, NSMALLBINS + SLAB_CLASS(GET(SLAB_OBJSIZE(SLAB_OF(ptr)))));
+#else
+        arena_lock(ARENA_OF(ptr));
+        slab_free(ptr);
+        arena_unlock();
+#endif
+        return;
+    }
+
+    // mmap 블록은 매핑을 통째로 시스템에 반환
+    if (GET_MAPPED(HDRP(ptr))) {
+        mem_unmap((char *)ptr - DSIZE);
+        return;
+    }
+
+#ifdef MM_THREADS
     size_t size = GET_SIZE(HDRP(ptr));
 
-    // H, F를 0으로 할당
-    PUT(HDRP(ptr), PACK(size, 0));
-    PUT(FTRP(ptr), PACK(size, 0));
+    if (size < SMALLBIN_LIMIT) {
+        tcache_free(ptr, size >> 3);
+        return;
+    }
+#endif
 
-    coalesce(ptr);
+    // 블록이 속한 아레나에 반환
+    arena_lock(ARENA_OF(ptr));
+    arena_free(ptr);
+    arena_unlock();
 }
 
 /*
- * mm_realloc - Implemented simply in terms of mm_malloc and mm_free
+ * mm_realloc - 가능하면 제자리에서 크기를 조정하고, 안 되면 새로 할당 후 복사
  */
 void *mm_realloc(void *ptr, size_t size) {
     void *oldptr = ptr;
     void *newptr;
     size_t copySize;
-    
+    size_t asize, oldsize;
+
+    if (ptr == NULL) {
+        return mm_malloc(size);
+    }
+
+    if (size == 0) {
+        mm_free(ptr);
+        return NULL;
+    }
+
+    // slab 객체는 객체 크기 안이면 그대로 두고, 넘으면 새로 할당 후 복사
+    if (is_slab(oldptr)) {
+        oldsize = GET(SLAB_OBJSIZE(SLAB_OF(oldptr)));
+        if (size <= oldsize) {
+            return oldptr;
+        }
+        if ((newptr = mm_malloc(size)) == NULL) {
+            return NULL;
+        }
+        memcpy(newptr, oldptr, oldsize);
+        mm_free(oldptr);
+        return newptr;
+    }
+
+    // mmap 블록은 매핑 크기를 조정
+    if (GET_MAPPED(HDRP(oldptr))) {
+        return mmap_realloc(oldptr, size);
+    }
+
+    asize = adjust_size(size);
+    oldsize = GET_SIZE(HDRP(oldptr));
+
+    // MMAP_THRESHOLD 이상으로 커지면 힙에서 늘리지 않고 mmap 블록으로 옮김
+    // 이후로는 매핑 크기만 조정하면 되므로 복사는 이번 한 번뿐
+    if ((asize <= oldsize || asize < MMAP_THRESHOLD) && resize_in_place(oldptr, asize)) {
+        return oldptr;
+    }
+
+    // 4) 제자리에서 늘릴 수 없는 경우: 새로 할당 후 복사
     newptr = mm_malloc(size);
     if (newptr == NULL) {
         return NULL;
     }
 
-    copySize = GET_SIZE(HDRP(oldptr));
-
-    // 기존 사이즈가 요청 사이즈보다 크면, 기존 사이즈 갱신
+    // 기존 payload(H, F 제외)만큼만 복사
+    copySize = oldsize - DSIZE;
     if (size < copySize) {
         copySize = size;
     }
@@ -209,8 +563,560 @@ void *mm_realloc(void *ptr, size_t size) {
     return newptr;
 }
 
+/*
+ * mm_heapwalk - 힙의 블록을 주소 순서대로 visit에 넘김 (mdriver -F)
+ * fast bin의 블록은 가용 블록으로, slab은 객체 하나하나로 보고
+ * 힙 밖의 mmap 블록과 스레드 캐시 안의 블록(할당 블록으로 보임)은 제외
+ */
+void mm_heapwalk(void (*visit)(void *bp, size_t size, int alloc)) {
+    char *bp;
+#if MM_NARENAS > 1
+    char *end = (char *)mem_heap_hi() + 1;
+#endif
+
+    for (int i = 0; i < MM_NARENAS; i++) {
+#ifdef MM_THREADS
+        pthread_mutex_lock(&arenas[i].lock);
+#endif
+        for (int class = 0; class < NFASTBINS; class++) {
+            for (bp = arenas[i].fastbins[class]; bp != NULL; bp = NEXT(bp)) {
+                PUT(HDRP(bp), GET(HDRP(bp)) | FASTBIN_MARK);
+            }
+        }
+    }
+
+    bp = NEXT_BLKP(heap_listp);
+    while (1) {
+        for (; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+            walk_block(bp, visit);
+        }
+
+#if MM_NARENAS > 1
+        // 에필로그 뒤에 다른 세그먼트가 있으면 맵 단위 경계로 건너뜀 (패딩, 프롤로그 H/F 다음이 첫 블록)
+        if (bp < end) {
+            bp += (-(bp - heap_base)) & ((1 << ARENA_MAP_SHIFT) - 1);
+            bp += 4*WSIZE;
+            continue;
+        }
+#endif
+        break;
+    }
+
+    for (int i = 0; i < MM_NARENAS; i++) {
+        for (int class = 0; class < NFASTBINS; class++) {
+            for (bp = arenas[i].fastbins[class]; bp != NULL; bp = NEXT(bp)) {
+                PUT(HDRP(bp), GET(HDRP(bp)) & ~FASTBIN_MARK);
+            }
+        }
+#ifdef MM_THREADS
+        pthread_mutex_unlock(&arenas[i].lock);
+#endif
+    }
+}
+
 // Jiwon Parameter & Function
 
+// 블록 하나를 visit에 넘김, slab은 헤더와 남는 끝부분을 할당 블록 하나로, 객체는 각각 보고
+static void walk_block(char *bp, void (*visit)(void *bp, size_t size, int alloc)) {
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t objsize, nobjs;
+
+    if (!is_slab(bp)) {
+        visit(bp, size, GET_ALLOC(HDRP(bp)) && !(GET(HDRP(bp)) & FASTBIN_MARK));
+        return;
+    }
+
+    objsize = GET(SLAB_OBJSIZE(bp));
+    nobjs = SLAB_NOBJS(objsize);
+    visit(bp, size - nobjs * objsize, 1);
+    for (size_t i = 0; i < nobjs; i++) {
+        visit(bp + SLAB_HDRSIZE + i * objsize, objsize,
+              (SLAB_BITMAP(bp)[i >> 6] >> (i & 63)) & 1);
+    }
+}
+
+// 1) ~ 3) 블록을 옮기지 않고 asize로 조정, 성공하면 1
+static int resize_in_place(void *bp, size_t asize) {
+    size_t oldsize = GET_SIZE(HDRP(bp));
+    size_t nextsize, needsize;
+    void *next;
+
+    // 제자리 조정은 블록이 속한 아레나를 잠그고 수행
+    arena_lock(ARENA_OF(bp));
+
+    // 1) 줄이는 경우: 남는 뒷부분을 가용 블록으로 분할
+    if (asize <= oldsize) {
+        shrink_block(bp, asize);
+        arena_unlock();
+        return 1;
+    }
+
+    next = NEXT_BLKP(bp);
+    nextsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+
+    // 2) 힙의 마지막 블록인 경우: 모자란 만큼만 힙을 확장해서 다음 가용 블록으로 만듦
+    //    (다음 블록이 에필로그이거나, 다음 가용 블록 뒤가 에필로그)
+    if (oldsize + nextsize < asize &&
+        HDRP(nextsize ? NEXT_BLKP(next) : next) == av->top && arena_at_top()) {
+        // 확장한 부분도 가용 블록이 되므로 최소 블록 크기 이상으로 확장
+        needsize = MAX(asize - oldsize - nextsize, 2 * DSIZE);
+        if (extend_heap(needsize/WSIZE) == NULL) {
+            arena_unlock();
+            return 0;
+        }
+
+        // 다른 아레나가 먼저 힙을 늘렸다면 새 세그먼트가 생겼을 뿐 다음 블록은 그대로
+        nextsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+    }
+
+    // 3) 다음 블록이 가용 블록이고 합쳐서 충분한 경우: 흡수 후 남는 부분은 분할
+    if (oldsize + nextsize >= asize) {
+        delete_block(next);
+        PUT(HDRP(bp), PACK(oldsize + nextsize, 1));
+        PUT(FTRP(bp), PACK(oldsize + nextsize, 1));
+        shrink_block(bp, asize);
+        arena_unlock();
+        return 1;
+    }
+
+    arena_unlock();
+
+    return 0;
+}
+
+// 페이지 매핑 하나를 블록 하나로 사용: 패딩(1워드), 헤더(매핑 크기 | MAPPED | 1), payload
+static void *mmap_malloc(size_t asize) {
+    size_t pagesize = mem_pagesize();
+    size_t mapsize = (asize + pagesize - 1) & ~(pagesize - 1);
+    char *map;
+
+    if ((map = mem_map(mapsize)) == (void *)-1) {
+        return NULL;
+    }
+
+    PUT(map + WSIZE, PACK(mapsize, MAPPED | 1));
+
+    return map + DSIZE;
+}
+
+// mmap 블록의 크기 조정: 매핑 크기를 바꾸고(필요하면 커널이 페이지를 옮김, 복사 없음)
+// MMAP_THRESHOLD보다 작아지면 힙 블록으로 옮김
+static void *mmap_realloc(void *ptr, size_t size) {
+    size_t asize = adjust_size(size);
+    size_t pagesize = mem_pagesize();
+    size_t oldsize = GET_SIZE(HDRP(ptr));
+    size_t mapsize = (asize + pagesize - 1) & ~(pagesize - 1);
+    char *map;
+    void *newptr;
+
+    if (asize >= MMAP_THRESHOLD) {
+        if (mapsize == oldsize) {
+            return ptr;
+        }
+        if ((map = mem_remap((char *)ptr - DSIZE, mapsize)) != (void *)-1) {
+            PUT(map + WSIZE, PACK(mapsize, MAPPED | 1));
+            return map + DSIZE;
+        }
+    }
+
+    // 힙으로 옮기거나 매핑을 늘리지 못한 경우: 새로 할당 후 복사
+    if ((newptr = mm_malloc(size)) == NULL) {
+        return NULL;
+    }
+    memcpy(newptr, ptr, MIN(size, oldsize - DSIZE));
+    mem_unmap((char *)ptr - DSIZE);
+
+    return newptr;
+}
+
+// 잠근 아레나의 slab에서 객체 하나를 할당, 빈 객체가 있는 slab이 없으면 새로 만듦
+static void *slab_malloc(int class) {
+    char *slab = av->slabs[class];
+    size_t objsize = (class + 1) * DSIZE;
+    unsigned long long *bitmap;
+    unsigned int nfree;
+    int word = 0;
+    int bit;
+
+    if (slab == NULL && (slab = slab_new(objsize)) == NULL) {
+        return NULL;
+    }
+
+    // 꺼진 비트가 있는 첫 워드에서 가장 낮은 꺼진 비트
+    bitmap = SLAB_BITMAP(slab);
+    while (bitmap[word] == ~0ULL) {
+        word++;
+    }
+    bit = __builtin_ctzll(~bitmap[word]);
+    bitmap[word] |= 1ULL << bit;
+
+    // 가득 찬 slab은 리스트에서 뺌
+    nfree = GET(SLAB_NFREE(slab)) - 1;
+    PUT(SLAB_NFREE(slab), nfree);
+    if (nfree == 0) {
+        slab_unlink(class, slab);
+    }
+
+    return slab + SLAB_HDRSIZE + (word * 64 + bit) * objsize;
+}
+
+// 잠근 아레나의 slab에 객체 반환
+// 가득 차 있던 slab은 다시 리스트에 넣고, 모두 비었으면 같은 크기의 slab이 더 있을 때 힙에 돌려줌
+static void slab_free(void *bp) {
+    char *slab = SLAB_OF(bp);
+    size_t objsize = GET(SLAB_OBJSIZE(slab));
+    size_t index = ((char *)bp - slab - SLAB_HDRSIZE) / objsize;
+    unsigned int nfree = GET(SLAB_NFREE(slab)) + 1;
+    int class = SLAB_CLASS(objsize);
+
+    SLAB_BITMAP(slab)[index >> 6] &= ~(1ULL << (index & 63));
+    PUT(SLAB_NFREE(slab), nfree);
+
+    if (nfree == 1) {
+        slab_link(class, slab);
+    } else if (nfree == SLAB_NOBJS(objsize) && (NEXT(slab) != NULL || PREV(slab) != NULL)) {
+        slab_unlink(class, slab);
+        slab_map[PAGE_INDEX(slab)] = 0;
+        arena_free(slab);
+    }
+}
+
+// payload가 페이지 경계에서 시작하는 힙 블록을 slab으로 초기화
+// 한 페이지만큼 여유 있게 할당한 뒤 경계 앞뒤로 남는 부분은 가용 블록으로 되돌림
+static char *slab_new(size_t objsize) {
+    size_t bsize = SLAB_SIZE;
+    size_t total, front, back;
+    unsigned long long *bitmap;
+    char *bp, *slab;
+
+    // 돌려받은 slab 자리처럼 페이지 경계를 품은 가용 블록이 있으면 그 블록을 사용
+    // 앞부분도 최소 블록 크기 이상이어야 가용 블록이 될 수 있음
+    if ((bp = find_fit(bsize)) != NULL) {
+        front = (-(unsigned long)bp) & (SLAB_SIZE - 1);
+        if (front != 0 && front < 2*DSIZE) {
+            front += SLAB_SIZE;
+        }
+        if (front + bsize <= GET_SIZE(HDRP(bp))) {
+            place(bp, front + bsize);
+        } else {
+            bp = NULL;
+        }
+    }
+
+    if (bp == NULL) {
+        if ((bp = arena_malloc(bsize + SLAB_SIZE + 2*DSIZE)) == NULL) {
+            return NULL;
+        }
+        front = (-(unsigned long)bp) & (SLAB_SIZE - 1);
+        if (front != 0 && front < 2*DSIZE) {
+            front += SLAB_SIZE;
+        }
+    }
+    total = GET_SIZE(HDRP(bp));
+    slab = bp + front;
+
+    back = total - front - bsize;
+    if (back < 2*DSIZE) {
+        bsize += back;
+        back = 0;
+    }
+
+    PUT(HDRP(slab), PACK(bsize, 1));
+    PUT(FTRP(slab), PACK(bsize, 1));
+    if (back != 0) {
+        PUT(HDRP(NEXT_BLKP(slab)), PACK(back, 0));
+        PUT(FTRP(NEXT_BLKP(slab)), PACK(back, 0));
+        coalesce(NEXT_BLKP(slab));
+    }
+    if (front != 0) {
+        PUT(HDRP(bp), PACK(front, 0));
+        PUT(FTRP(bp), PACK(front, 0));
+        coalesce(bp);
+    }
+
+    // slab_map이 표시할 수 있는 범위 밖이면 slab으로 쓰지 않음
+    if (PAGE_INDEX(slab) >= ARENA_MAP_SIZE) {
+        arena_free(slab);
+        return NULL;
+    }
+
+    // 객체 수를 넘는 비트는 미리 켜서 할당되지 않도록 함
+    bitmap = SLAB_BITMAP(slab);
+    memset(bitmap, 0, SLAB_SIZE/DSIZE/8);
+    for (size_t i = SLAB_NOBJS(objsize); i < SLAB_SIZE/DSIZE; i++) {
+        bitmap[i >> 6] |= 1ULL << (i & 63);
+    }
+
+    PUT(SLAB_OBJSIZE(slab), objsize);
+    PUT(SLAB_NFREE(slab), SLAB_NOBJS(objsize));
+    slab_map[PAGE_INDEX(slab)] = 1;
+    slab_link(SLAB_CLASS(objsize), slab);
+
+    return slab;
+}
+
+// slab 리스트의 맨 앞에 삽입 (LIFO)
+static void slab_link(int class, char *slab) {
+    char *head = av->slabs[class];
+
+    SET_PTR(NEXT_PTR(slab), head);
+    SET_PTR(PREV_PTR(slab), NULL);
+
+    if (head != NULL) {
+        SET_PTR(PREV_PTR(head), slab);
+    }
+
+    av->slabs[class] = slab;
+}
+
+static void slab_unlink(int class, char *slab) {
+    char *next = NEXT(slab);
+    char *prev = PREV(slab);
+
+    if (next != NULL) {
+        SET_PTR(PREV_PTR(next), prev);
+    }
+
+    if (prev != NULL) {
+        SET_PTR(NEXT_PTR(prev), next);
+    } else {
+        av->slabs[class] = next;
+    }
+}
+
+// 현재 스레드에 배정된 아레나, 처음 호출될 때 돌아가며 배정
+static arena_t *get_arena(void) {
+#if MM_NARENAS > 1
+    if (thread_arena == NULL) {
+        thread_arena = &arenas[__sync_fetch_and_add(&next_arena, 1) % MM_NARENAS];
+    }
+
+    return thread_arena;
+#else
+    return &arenas[0];
+#endif
+}
+
+static void arena_lock(arena_t *a) {
+#ifdef MM_THREADS
+    pthread_mutex_lock(&a->lock);
+#endif
+    av = a;
+}
+
+static void arena_unlock(void) {
+#ifdef MM_THREADS
+    pthread_mutex_unlock(&av->lock);
+#endif
+}
+
+// 잠근 아레나에서 블록 할당 (검색 -> 배치, 없으면 통합 -> 검색 -> 확장 -> 배치)
+static void *arena_malloc(size_t asize) {
+    // extendsize: 적당한 곳이 없으면 확장해야 함, 확장할 사이즈 저장
+    size_t extendsize;
+    char *bp;
+
+    // fast bin에 같은 크기의 블록이 있으면 분할/통합 없이 그대로 사용
+    if (asize < FASTBIN_LIMIT && (bp = av->fastbins[asize >> 3]) != NULL) {
+        av->fastbins[asize >> 3] = NEXT(bp);
+        av->fastcount--;
+        return bp;
+    }
+
+    // 가용 블록 검색 후 요청한 블록 배치 (검색 -> 배치)
+    if ((bp = find_fit(asize)) != NULL) {
+        place(bp, asize);
+        return bp;
+    }
+
+    // 맞는 블록이 없으면 미뤄둔 fast bin 블록들을 통합한 뒤 다시 검색
+    if (av->fastcount > 0) {
+        consolidate();
+        if ((bp = find_fit(asize)) != NULL) {
+            place(bp, asize);
+            return bp;
+        }
+    }
+
+    // 알맞은 가용 블록이 없을 경우 확장 후 블록 배치 (검색 -> 확장 -> 배치)
+    extendsize = MAX(asize, CHUNKSIZE);
+    if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
+        return NULL;
+    }
+
+    place(bp, asize);
+
+    return bp;
+}
+
+// 잠근 아레나에 블록 반환, 작은 블록은 fast bin에 넣고 통합을 미룸
+static void arena_free(void *ptr) {
+    size_t size = GET_SIZE(HDRP(ptr));
+
+    maybe_trim();
+
+    if (size < FASTBIN_LIMIT) {
+        SET_PTR(NEXT_PTR(ptr), av->fastbins[size >> 3]);
+        av->fastbins[size >> 3] = ptr;
+
+        if (++av->fastcount >= FASTBIN_MAX) {
+            consolidate();
+        }
+        return;
+    }
+
+    // H, F를 0으로 할당
+    PUT(HDRP(ptr), PACK(size, 0));
+    PUT(FTRP(ptr), PACK(size, 0));
+
+    ptr = coalesce(ptr);
+
+    // 큰 블록을 반환해서 힙 끝이 크게 비었으면 바로 줄임
+    if (size >= TRIM_CHECK && HDRP(NEXT_BLKP(ptr)) == av->top &&
+        GET_SIZE(HDRP(ptr)) >= TRIM_THRESHOLD) {
+        av->trim_wait = 0;
+        trim_heap(ptr);
+    }
+}
+
+#ifdef MM_THREADS
+// 스레드가 끝날 때 캐시에 남은 블록을 모두 아레나로 반납
+static void tcache_release(void *unused) {
+    if (tcache.epoch != heap_epoch) {
+        return;
+    }
+
+    for (int class = 0; class < TCACHE_BINS; class++) {
+        tcache_drain(class, tcache.counts[class]);
+    }
+}
+
+static void tcache_key_init(void) {
+    pthread_key_create(&tcache_key, tcache_release);
+}
+
+// 힙이 다시 초기화됐으면 이전 힙을 가리키는 캐시를 비움
+static inline void tcache_check(void) {
+    if (tcache.epoch == heap_epoch) {
+        return;
+    }
+
+    memset(&tcache, 0, sizeof(tcache));
+    tcache.epoch = heap_epoch;
+
+    pthread_once(&tcache_once, tcache_key_init);
+    pthread_setspecific(tcache_key, &tcache);
+}
+
+// 캐시가 비었으면 아레나에서 TCACHE_BATCH개를 연속된 한 덩어리로 할당해 잘라서 채움
+// 이웃 블록의 coalesce가 경계의 H, F를 읽으므로 자르는 것도 락 안에서 수행
+static void tcache_fill(int class, size_t asize) {
+    char *bp;
+    size_t total;
+    int n = TCACHE_BATCH;
+
+    arena_lock(get_arena());
+
+    // slab 객체는 slab에서 하나씩 꺼내 채움
+    if (class >= NSMALLBINS) {
+        while (n-- > 0 && (bp = slab_malloc(class - NSMALLBINS)) != NULL) {
+            SET_PTR(NEXT_PTR(bp), tcache.bins[class]);
+            tcache.bins[class] = bp;
+            tcache.counts[class]++;
+        }
+        arena_unlock();
+        return;
+    }
+
+    if ((bp = arena_malloc(asize * n)) == NULL) {
+        n = 1;
+        bp = arena_malloc(asize);
+    }
+
+    if (bp == NULL) {
+        arena_unlock();
+        return;
+    }
+
+    // 마지막 블록은 분할되지 않고 남은 부분까지 가짐
+    total = GET_SIZE(HDRP(bp));
+    for (int i = 0; i < n; i++) {
+        size_t bsize = (i == n - 1) ? total - asize * (n - 1) : asize;
+
+        PUT(HDRP(bp), PACK(bsize, 1));
+        PUT(FTRP(bp), PACK(bsize, 1));
+
+        SET_PTR(NEXT_PTR(bp), tcache.bins[class]);
+        tcache.bins[class] = bp;
+        tcache.counts[class]++;
+
+        bp = NEXT_BLKP(bp);
+    }
+    arena_unlock();
+}
+
+static void *tcache_malloc(int class, size_t asize) {
+    char *bp;
+
+    tcache_check();
+
+    if (tcache.bins[class] == NULL) {
+        tcache_fill(class, asize);
+        if (tcache.bins[class] == NULL) {
+            return NULL;
+        }
+    }
+
+    bp = tcache.bins[class];
+    tcache.bins[class] = NEXT(bp);
+    tcache.counts[class]--;
+
+    return bp;
+}
+
+// 캐시가 가득 찼으면 TCACHE_BATCH개를 한 번에 아레나로 반납한 뒤 캐시에 넣음
+static void tcache_free(void *ptr, int class) {
+    tcache_check();
+
+    if (tcache.counts[class] >= TCACHE_MAX) {
+        tcache_drain(class, TCACHE_BATCH);
+    }
+
+    SET_PTR(NEXT_PTR(ptr), tcache.bins[class]);
+    tcache.bins[class] = ptr;
+    tcache.counts[class]++;
+}
+
+// 캐시 bin에서 n개를 꺼내 각자 속한 아레나로 반납, 같은 아레나가 이어지면 락을 유지
+static void tcache_drain(int class, int n) {
+    arena_t *locked = NULL;
+    char *bp;
+
+    while (n-- > 0 && (bp = tcache.bins[class]) != NULL) {
+        tcache.bins[class] = NEXT(bp);
+        tcache.counts[class]--;
+
+        if (ARENA_OF(bp) != locked) {
+            if (locked != NULL) {
+                arena_unlock();
+            }
+            locked = ARENA_OF(bp);
+            arena_lock(locked);
+        }
+
+        if (class >= NSMALLBINS) {
+            slab_free(bp);
+        } else {
+            arena_free(bp);
+        }
+    }
+
+    if (locked != NULL) {
+        arena_unlock();
+    }
+}
+#endif
+
 // 1) 힙이 초기화될 때: 초기화 후 초기 가용 블록을 생성하기 위해 호출
 // 2) 요청한 크기를 할당할만한 충분한 공간을 찾지 못했을 때: 추가 힙 공간을 요청
 static void *extend_heap(size_t words) {
@@ -219,9 +1125,29 @@ static void *extend_heap(size_t words) {
 
     // 2워드의 배수로 만들어 byte 단위로 만들어줌
 	size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+
+#if MM_NARENAS > 1
+    pthread_mutex_lock(&sbrk_lock);
+
+    // 다른 아레나가 힙 끝을 차지하고 있으면 새 세그먼트를 만듦
+    // 세그먼트를 자주 만들지 않도록 최소 ARENA_SEGMENT 크기로 만듦
+    if (av->top == NULL || av->top + WSIZE != (char *)mem_heap_hi() + 1) {
+        bp = new_segment(MAX(size, ARENA_SEGMENT));
+        pthread_mutex_unlock(&sbrk_lock);
+        return (bp == NULL) ? NULL : coalesce(bp);
+    }
+
+    if ((long)(bp = mem_sbrk(size)) == -1) {
+        pthread_mutex_unlock(&sbrk_lock);
+        return NULL;
+    }
+    map_arena(bp, size);
+    pthread_mutex_unlock(&sbrk_lock);
+#else
 	if ((long)(bp = mem_sbrk(size)) == -1) {
 	    return NULL;
     }
+#endif
 
     // 새로운 가용 블록의 H, F 생성
 	PUT(HDRP(bp), PACK(size, 0));
@@ -230,10 +1156,109 @@ static void *extend_heap(size_t words) {
     // 새로 가용 블록을 만들었으니 에필로그를 새롭게 위치 시켜야 함
     // 에필로그는 새로 만든 블록의 다음 블록
 	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+    av->top = HDRP(NEXT_BLKP(bp));
 
 	return coalesce(bp);
 }
 
+// 아레나의 마지막 블록이 큰 가용 블록인 채로 free가 TRIM_DELAY번 이어졌으면 힙을 줄임
+static void maybe_trim(void) {
+    // 에필로그 바로 앞이 마지막 블록의 F
+    char *ftr = av->top - WSIZE;
+
+    if (GET_ALLOC(ftr) || GET_SIZE(ftr) < TRIM_THRESHOLD) {
+        av->trim_wait = 0;
+        return;
+    }
+
+    if (++av->trim_wait >= TRIM_DELAY) {
+        av->trim_wait = 0;
+        trim_heap(av->top - GET_SIZE(ftr) + WSIZE);
+    }
+}
+
+// extend_heap의 반대: 힙 끝의 큰 가용 블록에서 TRIM_PAD만 남기고 페이지 단위로 힙을 줄임
+// 아레나가 여러 개면 다른 아레나가 힙을 늘리지 못하도록 sbrk_lock 안에서 수행
+static void trim_heap(void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t excess;
+
+    excess = (size - TRIM_PAD) & ~(mem_pagesize() - 1);
+
+#if MM_NARENAS > 1
+    pthread_mutex_lock(&sbrk_lock);
+#endif
+    // 이 아레나의 마지막 세그먼트가 힙 끝에 있을 때만 줄일 수 있음
+    if (av->top + WSIZE == (char *)mem_heap_hi() + 1) {
+        delete_block(bp);
+        mem_sbrk(-(int)excess);
+        size -= excess;
+        PUT(HDRP(bp), PACK(size, 0));
+        PUT(FTRP(bp), PACK(size, 0));
+        PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+        av->top = HDRP(NEXT_BLKP(bp));
+        insert_block(bp, size);
+    }
+#if MM_NARENAS > 1
+    pthread_mutex_unlock(&sbrk_lock);
+#endif
+}
+
+// 현재 아레나의 마지막 세그먼트가 힙 끝에 있어 이어서 확장할 수 있는지
+static int arena_at_top(void) {
+    int at_top;
+
+#if MM_NARENAS > 1
+    pthread_mutex_lock(&sbrk_lock);
+#endif
+    at_top = (av->top + WSIZE == (char *)mem_heap_hi() + 1);
+#if MM_NARENAS > 1
+    pthread_mutex_unlock(&sbrk_lock);
+#endif
+
+    return at_top;
+}
+
+#if MM_NARENAS > 1
+// 힙 구간 [bp, bp + size)를 현재 아레나 소유로 기록
+static void map_arena(char *bp, size_t size) {
+    size_t first = (bp - heap_base) >> ARENA_MAP_SHIFT;
+    size_t last = (bp + size - 1 - heap_base) >> ARENA_MAP_SHIFT;
+
+    memset(&arena_map[first], av - arenas, last - first + 1);
+}
+
+// 맵 단위 경계에서 시작하는 새 세그먼트: 패딩, 프롤로그 H/F, 가용 블록, 에필로그
+// 세그먼트끼리는 프롤로그/에필로그로 막혀 있어 다른 아레나 블록과 통합되지 않음
+static void *new_segment(size_t size) {
+    size_t offset = (char *)mem_heap_hi() + 1 - heap_base;
+    size_t pad = (-offset) & ((1 << ARENA_MAP_SHIFT) - 1);
+    char *seg;
+
+    if (((offset + pad + 4*WSIZE + size) >> ARENA_MAP_SHIFT) >= ARENA_MAP_SIZE) {
+        return NULL;
+    }
+
+    if ((long)(seg = mem_sbrk(pad + 4*WSIZE + size)) == -1) {
+        return NULL;
+    }
+    seg += pad;
+    map_arena(seg, 4*WSIZE + size);
+
+    PUT(seg, 0);
+    PUT(seg + (1*WSIZE), PACK(DSIZE, 1));
+    PUT(seg + (2*WSIZE), PACK(DSIZE, 1));
+
+    seg += 4*WSIZE;
+    PUT(HDRP(seg), PACK(size, 0));
+    PUT(FTRP(seg), PACK(size, 0));
+    PUT(HDRP(NEXT_BLKP(seg)), PACK(0, 1));
+    av->top = HDRP(NEXT_BLKP(seg));
+
+    return seg;
+}
+#endif
+
 // 할당 블록을 가용 블록으로 변환할 때,
 // 해당 블록의 인접 블록이 가용 블록인지 확인해야 한다
 static void *coalesce(void *bp) {
@@ -278,35 +1303,56 @@ static void *coalesce(void *bp) {
     return bp;
 }
 
-static void *find_fit(size_t asize) {
+// fast bin의 블록을 모두 가용 상태로 바꾸고 이웃 블록과 통합해 bin에 넣음
+static void consolidate(void) {
     char *bp;
+    size_t size;
 
-    int class = 0;
-    size_t target = asize;
+    for (int class = 0; class < NFASTBINS; class++) {
+        while ((bp = av->fastbins[class]) != NULL) {
+            av->fastbins[class] = NEXT(bp);
 
-    // 분리 가용 리스트에서 가용 리스트 검색
-    while (class < LISTLIMIT) {
-        // 1) 마지막 클래스거나,
-        // 2) target이 1보다 작거나 같고 가용 리스트 값이 널이 아닐 때,
-        if ((class == LISTLIMIT - 1) || ((target <= 1) && (free_list[class] != NULL))) {
-            bp = free_list[class];
+            size = GET_SIZE(HDRP(bp));
+            PUT(HDRP(bp), PACK(size, 0));
+            PUT(FTRP(bp), PACK(size, 0));
+            coalesce(bp);
+        }
+    }
 
-            // 가용 상태이고, 요청한 사이즈만큼 충분한 공간이 있을 때
-            while ((bp != NULL) && ((asize > GET_SIZE(HDRP(bp))))) {
-                bp = NEXT(bp);
-            }
+    av->fastcount = 0;
+}
 
-            if (bp != NULL) {
-                return bp;
-            }
+static void *find_fit(size_t asize) {
+    char *bp;
+    unsigned long long candidates;
+
+    int class = bin_index(asize);
+
+    // 1) small bin은 크기가 정확히 같으므로 맨 앞 블록을 바로 사용
+    // 2) large bin은 트리에서 asize 이상인 가장 작은 블록 (best-fit)
+    if (class < NSMALLBINS) {
+        if (av->free_list[class] != NULL) {
+            return av->free_list[class];
         }
-        
-        target >>= 1;
+    } else if ((bp = tree_best_fit(av->free_list[class], asize)) != NULL) {
+        return bp;
+    }
+
+    // 더 큰 bin 중 비어있지 않은 첫 번째 bin, 그 안의 블록은 모두 asize 이상
+    candidates = av->binmap & (~0ULL << (class + 1));
+    if (candidates == 0) {
+        return NULL;
+    }
 
-        class++;
+    class = __builtin_ctzll(candidates);
+    if (class < NSMALLBINS) {
+        return av->free_list[class];
     }
 
-    return NULL;
+    // 트리의 최소값이 그 bin에서의 best-fit
+    for (bp = av->free_list[class]; LEFT(bp) != av->nil; bp = LEFT(bp));
+
+    return bp;
 }
 
 // 맞는 블록이 있으면 배치하고, 남으면 가용 블록으로 분할
@@ -335,101 +1381,348 @@ static void place(void *bp, size_t asize){
     }
 }
 
+// 할당 블록을 asize로 줄이고, 남는 부분이 최소 블록 이상이면 가용 블록으로 반환
+static void shrink_block(void *bp, size_t asize) {
+    size_t csize = GET_SIZE(HDRP(bp));
+
+    if ((csize - asize) < (2 * DSIZE)) {
+        return;
+    }
+
+    PUT(HDRP(bp), PACK(asize, 1));
+    PUT(FTRP(bp), PACK(asize, 1));
+
+    // 뒤의 가용 블록과 통합되도록 coalesce를 거침
+    bp = NEXT_BLKP(bp);
+    PUT(HDRP(bp), PACK(csize - asize, 0));
+    PUT(FTRP(bp), PACK(csize - asize, 0));
+    coalesce(bp);
+}
+
+// small bin은 가용 리스트의 맨 앞에 삽입 (LIFO), large bin은 트리에 삽입
 static void insert_block(void *ptr, size_t size) {
-    int class = 0;
+    int class = bin_index(size);
+    void *head = av->free_list[class];
 
-    // search_ptr: 노드 자리를 검색해나감, insert_ptr: 실제 노드가 삽입되는 위치
-    void *search_ptr = ptr; 
-    void *insert_ptr = NULL; 
-    
-    // 분리 가용 리스트 중에서 적절한 것을 선택함
-    while ((class < LISTLIMIT - 1) && (size > 1)) {
-        size >>= 1;
-        class++;
+    if (class >= NSMALLBINS) {
+        tree_insert(&av->free_list[class], ptr);
+        av->binmap |= 1ULL << class;
+        return;
     }
-    
-    // 크기가 작은 것부터 검색함
-    // 분리 가용 리스트의 시작 위치를 search_ptr에 저장
-    search_ptr = free_list[class];
-    while ((search_ptr != NULL) && (size > GET_SIZE(HDRP(search_ptr)))) {
-        insert_ptr = search_ptr;
-        search_ptr = NEXT(search_ptr);
+
+    SET_PTR(NEXT_PTR(ptr), head);
+    SET_PTR(PREV_PTR(ptr), NULL);
+
+    if (head != NULL) {
+        SET_PTR(PREV_PTR(head), ptr);
     }
-    
-    if (search_ptr != NULL) {
-        // 1) 분리 가용 리스트의 가운데로 삽입할 때,
-        if (insert_ptr != NULL) {
-            SET_PTR(NEXT_PTR(ptr), search_ptr);
-            SET_PTR(PREV_PTR(search_ptr), ptr);
-            SET_PTR(PREV_PTR(ptr), insert_ptr);
-            SET_PTR(NEXT_PTR(insert_ptr), ptr);
-
-        // 2) 분리 가용 리스트의 맨 처음에 삽입할 때,
-        } else {
-            SET_PTR(NEXT_PTR(ptr), search_ptr);
-            SET_PTR(PREV_PTR(search_ptr), ptr);
-            SET_PTR(PREV_PTR(ptr), NULL);
-            
-            // 분리 가용 리스트의 시작 위치를 search_ptr에 저장
-            free_list[class] = ptr;
+
+    av->free_list[class] = ptr;
+    av->binmap |= 1ULL << class;
+}
+
+static void delete_block(void *ptr) {
+    int class = bin_index(GET_SIZE(HDRP(ptr)));
+    char *next;
+    char *prev;
+
+    if (class >= NSMALLBINS) {
+        tree_delete(&av->free_list[class], ptr);
+
+        // 트리가 비었으면 bin 표시를 지움
+        if (av->free_list[class] == av->nil) {
+            av->binmap &= ~(1ULL << class);
         }
+        return;
+    }
+
+    next = NEXT(ptr);
+    prev = PREV(ptr);
+
+    if (next != NULL) {
+        SET_PTR(PREV_PTR(next), prev);
+    }
+
+    // 1) 가운데나 맨 마지막 원소일 때, 이전 블록이 다음 블록을 가리킴
+    if (prev != NULL) {
+        SET_PTR(NEXT_PTR(prev), next);
 
+    // 2) 맨 처음 원소일 때, 가용 리스트의 시작 위치를 다음 블록으로 갱신
     } else {
-        // 3) 분리 가용 리스트의 맨 마지막에 삽입할 때,
-        if (insert_ptr != NULL) {
-            SET_PTR(NEXT_PTR(ptr), NULL);
-            SET_PTR(PREV_PTR(ptr), insert_ptr);
-            SET_PTR(NEXT_PTR(insert_ptr), ptr);
+        av->free_list[class] = next;
 
-        // 4) 분리 가용 리스트에 원소가 없을 때,
+        // 리스트가 비었으면 bin 표시를 지움
+        if (next == NULL) {
+            av->binmap &= ~(1ULL << class);
+        }
+    }
+}
+
+// large bin 트리의 정렬 기준: 크기가 같으면 주소가 낮은 블록이 앞
+static inline int tree_less(char *a, char *b) {
+    size_t asize = GET_SIZE(HDRP(a));
+    size_t bsize = GET_SIZE(HDRP(b));
+
+    return (asize < bsize) || (asize == bsize && a < b);
+}
+
+// asize 이상인 블록 중 가장 작은 블록, 없으면 NULL
+static char *tree_best_fit(void *root, size_t asize) {
+    char *x = root;
+    char *best = NULL;
+
+    while (x != av->nil) {
+        if (GET_SIZE(HDRP(x)) >= asize) {
+            best = x;
+            x = LEFT(x);
         } else {
-            SET_PTR(NEXT_PTR(ptr), NULL);
-            SET_PTR(PREV_PTR(ptr), NULL);
-            
-            // 분리 가용 리스트의 시작 위치를 search_ptr에 저장
-            free_list[class] = ptr;
+            x = RIGHT(x);
         }
     }
-    
-    return;
+
+    return best;
 }
 
-static void delete_block(void *ptr) {
-    size_t size = GET_SIZE(HDRP(ptr));
+static void tree_left_rotate(void **root, char *x) {
+    char *y = RIGHT(x);
 
-    int list = 0;
-    
-    // 분리 가용 리스트 중에서 적절한 것을 선택함
-    while ((list < LISTLIMIT - 1) && (size > 1)) {
-        size >>= 1;
-        list++;
+    SET_NODE(RIGHT_PTR(x), LEFT(y));
+    if (LEFT(y) != av->nil) {
+        SET_NODE(PARENT_PTR(LEFT(y)), x);
     }
-    
-    if (NEXT(ptr) != NULL) { 
-        // 1) 분리 가용 리스트의 가운데로 삽입할 때,
-        if (PREV(ptr) != NULL) {
-            SET_PTR(PREV_PTR(NEXT(ptr)), PREV(ptr));
-            SET_PTR(NEXT_PTR(PREV(ptr)), NEXT(ptr));
+    SET_NODE(PARENT_PTR(y), PARENT(x));
 
-        // 2) 분리 가용 리스트의 맨 처음에 삽입할 때,
-        } else {
-            SET_PTR(PREV_PTR(NEXT(ptr)), NULL);
+    // X의 부모가 nil이라는 것은, X가 root라는 뜻
+    if (PARENT(x) == av->nil) {
+        *root = y;
+    } else if (x == LEFT(PARENT(x))) {
+        SET_NODE(LEFT_PTR(PARENT(x)), y);
+    } else {
+        SET_NODE(RIGHT_PTR(PARENT(x)), y);
+    }
+
+    SET_NODE(LEFT_PTR(y), x);
+    SET_NODE(PARENT_PTR(x), y);
+}
+
+static void tree_right_rotate(void **root, char *x) {
+    char *y = LEFT(x);
+
+    SET_NODE(LEFT_PTR(x), RIGHT(y));
+    if (RIGHT(y) != av->nil) {
+        SET_NODE(PARENT_PTR(RIGHT(y)), x);
+    }
+    SET_NODE(PARENT_PTR(y), PARENT(x));
+
+    // X의 부모가 nil이라는 것은, X가 root라는 뜻
+    if (PARENT(x) == av->nil) {
+        *root = y;
+    } else if (x == RIGHT(PARENT(x))) {
+        SET_NODE(RIGHT_PTR(PARENT(x)), y);
+    } else {
+        SET_NODE(LEFT_PTR(PARENT(x)), y);
+    }
+
+    SET_NODE(RIGHT_PTR(y), x);
+    SET_NODE(PARENT_PTR(x), y);
+}
+
+static void tree_insert(void **root, char *z) {
+    char *x = *root;
+    char *y = av->nil;
+    char *uncle;
+
+    while (x != av->nil) {
+        y = x;
+        x = tree_less(z, x) ? LEFT(x) : RIGHT(x);
+    }
+
+    SET_NODE(PARENT_PTR(z), y);
+    if (y == av->nil) {
+        *root = z;
+    } else if (tree_less(z, y)) {
+        SET_NODE(LEFT_PTR(y), z);
+    } else {
+        SET_NODE(RIGHT_PTR(y), z);
+    }
 
-            // 분리 가용 리스트의 시작 위치를 다음 블록으로 갱신
-            free_list[list] = NEXT(ptr);
+    SET_NODE(LEFT_PTR(z), av->nil);
+    SET_NODE(RIGHT_PTR(z), av->nil);
+    PUT(COLOR_PTR(z), RED);
+
+    // 부모가 RED인 동안 색 변경과 회전으로 속성 복구
+    while (COLOR(PARENT(z)) == RED) {
+        char *parent = PARENT(z);
+        char *grand = PARENT(parent);
+
+        if (parent == LEFT(grand)) {
+            uncle = RIGHT(grand);
+
+            // Case 1: 삼촌 RED
+            if (COLOR(uncle) == RED) {
+                PUT(COLOR_PTR(parent), BLACK);
+                PUT(COLOR_PTR(uncle), BLACK);
+                PUT(COLOR_PTR(grand), RED);
+                z = grand;
+            } else {
+                // Case 2: Z가 오른쪽 자식
+                if (z == RIGHT(parent)) {
+                    z = parent;
+                    tree_left_rotate(root, z);
+                }
+
+                // Case 3: Z가 왼쪽 자식
+                PUT(COLOR_PTR(PARENT(z)), BLACK);
+                PUT(COLOR_PTR(PARENT(PARENT(z))), RED);
+                tree_right_rotate(root, PARENT(PARENT(z)));
+            }
+        } else {
+            uncle = LEFT(grand);
+
+            // Case 1: 삼촌 RED
+            if (COLOR(uncle) == RED) {
+                PUT(COLOR_PTR(parent), BLACK);
+                PUT(COLOR_PTR(uncle), BLACK);
+                PUT(COLOR_PTR(grand), RED);
+                z = grand;
+            } else {
+                // Case 2: Z가 왼쪽 자식
+                if (z == LEFT(parent)) {
+                    z = parent;
+                    tree_right_rotate(root, z);
+                }
+
+                // Case 3: Z가 오른쪽 자식
+                PUT(COLOR_PTR(PARENT(z)), BLACK);
+                PUT(COLOR_PTR(PARENT(PARENT(z))), RED);
+                tree_left_rotate(root, PARENT(PARENT(z)));
+            }
         }
+    }
+
+    // Root 노드는 항상 Black
+    PUT(COLOR_PTR(*root), BLACK);
+}
+
+static void tree_transplant(void **root, char *u, char *v) {
+    if (PARENT(u) == av->nil) {
+        *root = v;
+    } else if (u == LEFT(PARENT(u))) {
+        SET_NODE(LEFT_PTR(PARENT(u)), v);
     } else {
-        // 3) 분리 가용 리스트의 맨 마지막에 삽입할 때,
-        if (PREV(ptr) != NULL) {
-            SET_PTR(NEXT_PTR(PREV(ptr)), NULL);
+        SET_NODE(RIGHT_PTR(PARENT(u)), v);
+    }
+
+    SET_NODE(PARENT_PTR(v), PARENT(u));
+}
+
+static void tree_delete(void **root, char *z) {
+    char *y = z;
+    char *x;
+    char *w;
+    unsigned int y_original_color = COLOR(y);
+
+    // 1) 오른쪽 자식만 있는 경우
+    if (LEFT(z) == av->nil) {
+        x = RIGHT(z);
+        tree_transplant(root, z, RIGHT(z));
+
+    // 2) 왼쪽 자식만 있는 경우
+    } else if (RIGHT(z) == av->nil) {
+        x = LEFT(z);
+        tree_transplant(root, z, LEFT(z));
+
+    // 3) 두 자식 다 있는 경우: Z의 Successor Y가 Z 자리로 이동
+    } else {
+        for (y = RIGHT(z); LEFT(y) != av->nil; y = LEFT(y));
+
+        y_original_color = COLOR(y);
+        x = RIGHT(y);
+
+        if (PARENT(y) == z) {
+            SET_NODE(PARENT_PTR(x), y);
+        } else {
+            tree_transplant(root, y, RIGHT(y));
+            SET_NODE(RIGHT_PTR(y), RIGHT(z));
+            SET_NODE(PARENT_PTR(RIGHT(y)), y);
+        }
 
-        // 4) 분리 가용 리스트의 마지막 원소일 때,
+        tree_transplant(root, z, y);
+        SET_NODE(LEFT_PTR(y), LEFT(z));
+        SET_NODE(PARENT_PTR(LEFT(y)), y);
+        PUT(COLOR_PTR(y), COLOR(z));
+    }
+
+    // 삭제한 색이 BLACK일 때만 속성 위반 가능
+    if (y_original_color != BLACK) {
+        return;
+    }
+
+    while (x != *root && COLOR(x) == BLACK) {
+        if (x == LEFT(PARENT(x))) {
+            w = RIGHT(PARENT(x));
+
+            // Case 1: 형제 노드 RED
+            if (COLOR(w) == RED) {
+                PUT(COLOR_PTR(w), BLACK);
+                PUT(COLOR_PTR(PARENT(x)), RED);
+                tree_left_rotate(root, PARENT(x));
+                w = RIGHT(PARENT(x));
+            }
+
+            // Case 2: 형제의 두 자식 BLACK
+            if (COLOR(LEFT(w)) == BLACK && COLOR(RIGHT(w)) == BLACK) {
+                PUT(COLOR_PTR(w), RED);
+                x = PARENT(x);
+            } else {
+                // Case 3: 형제의 오른쪽 자식 BLACK
+                if (COLOR(RIGHT(w)) == BLACK) {
+                    PUT(COLOR_PTR(LEFT(w)), BLACK);
+                    PUT(COLOR_PTR(w), RED);
+                    tree_right_rotate(root, w);
+                    w = RIGHT(PARENT(x));
+                }
+
+                // Case 4: 형제의 오른쪽 자식 RED
+                PUT(COLOR_PTR(w), COLOR(PARENT(x)));
+                PUT(COLOR_PTR(PARENT(x)), BLACK);
+                PUT(COLOR_PTR(RIGHT(w)), BLACK);
+                tree_left_rotate(root, PARENT(x));
+                x = *root;
+            }
         } else {
+            w = LEFT(PARENT(x));
+
+            // Case 1: 형제 노드 RED
+            if (COLOR(w) == RED) {
+                PUT(COLOR_PTR(w), BLACK);
+                PUT(COLOR_PTR(PARENT(x)), RED);
+                tree_right_rotate(root, PARENT(x));
+                w = LEFT(PARENT(x));
+            }
 
-            // 분리 가용 리스트의 시작 위치를 Null로 갱신
-            free_list[list] = NULL;
+            // Case 2: 형제의 두 자식 BLACK
+            if (COLOR(RIGHT(w)) == BLACK && COLOR(LEFT(w)) == BLACK) {
+                PUT(COLOR_PTR(w), RED);
+                x = PARENT(x);
+            } else {
+                // Case 3: 형제의 왼쪽 자식 BLACK
+                if (COLOR(LEFT(w)) == BLACK) {
+                    PUT(COLOR_PTR(RIGHT(w)), BLACK);
+                    PUT(COLOR_PTR(w), RED);
+                    tree_left_rotate(root, w);
+                    w = LEFT(PARENT(x));
+                }
+
+                // Case 4: 형제의 왼쪽 자식 RED
+                PUT(COLOR_PTR(w), COLOR(PARENT(x)));
+                PUT(COLOR_PTR(PARENT(x)), BLACK);
+                PUT(COLOR_PTR(LEFT(w)), BLACK);
+                tree_right_rotate(root, PARENT(x));
+                x = *root;
+            }
         }
     }
-    
-    return;
-}
\ No newline at end of file
+
+    PUT(COLOR_PTR(x), BLACK);
+}
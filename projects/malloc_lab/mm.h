@@ -5,6 +5,13 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/*
+ * Heap walk for the fragmentation profile (mdriver -F): calls visit
+ * once for every block in the heap, in address order, with the block,
+ * its size in bytes including headers, and whether it is allocated.
+ */
+extern void mm_heapwalk(void (*visit)(void *bp, size_t size, int alloc));
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
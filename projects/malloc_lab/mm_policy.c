@@ -1,6 +1,6 @@
 /*
  * mm-naive.c - The fastest, least memory-efficient malloc package.
- * 
+ *
  * In this naive approach, a block is allocated by simply incrementing
  * the brk pointer.  A block is pure payload. There are no headers or
  * footers.  Blocks are never coalesced or reused. Realloc is
@@ -8,9 +8,27 @@
  *
  * NOTE TO STUDENTS: Replace this header comment with your own header
  * comment that gives a high level description of your solution.
- * 
- * Seglist
- * Perf index = 45 (util) + 40 (thru) = 85/100
+ *
+ * Policy core: 가용 블록 관리, 검색 방법, 통합 시점을 컴파일할 때 선택
+ * (make mdriver-<list>-<fit>-<coalesce>, make policy-report로 비교)
+ *
+ * -DMM_LIST=
+ *   LIST_IMPLICIT: 가용 리스트 없이 힙의 블록을 순서대로 검색
+ *   LIST_EXPLICIT: 가용 블록끼리 이중 연결 리스트 하나 (LIFO)
+ *   LIST_SEGLIST: 크기 구간 [2^k, 2^(k+1))별 가용 리스트 (LIFO)
+ * -DMM_FIT=
+ *   FIT_FIRST: 처음 찾은 맞는 블록
+ *   FIT_NEXT: 이전 검색이 끝난 자리부터 검색 (seglist는 리스트마다)
+ *   FIT_BEST: 맞는 블록 중 가장 작은 블록
+ * -DMM_COALESCE=
+ *   COALESCE_IMMEDIATE: free할 때마다 인접 가용 블록과 통합
+ *   COALESCE_DEFERRED: free는 가용 표시만 하고, 맞는 블록이 없을 때 힙 전체를 한 번에 통합
+ *
+ * 예전 구현과의 대응
+ *   implicit-first-immediate: mm_implicit_first_fit.c
+ *   implicit-next-immediate: mm_implicit_next_fit.c
+ *   explicit-first-immediate: mm_explicit_first_fit.c
+ *   seglist-best-immediate: mm_seglist.c (리스트를 크기순으로 정렬해 두던 것을 best-fit 검색으로)
  */
 
 #include <stdio.h>
@@ -39,16 +57,41 @@ team_t team = {
     ""
 };
 
+// 정책 번호, 선택하지 않으면 mm_seglist.c와 같은 조합
+#define LIST_IMPLICIT 0
+#define LIST_EXPLICIT 1
+#define LIST_SEGLIST 2
+
+#define FIT_FIRST 0
+#define FIT_NEXT 1
+#define FIT_BEST 2
+
+#define COALESCE_IMMEDIATE 0
+#define COALESCE_DEFERRED 1
+
+#ifndef MM_LIST
+#define MM_LIST LIST_SEGLIST
+#endif
+#ifndef MM_FIT
+#define MM_FIT FIT_BEST
+#endif
+#ifndef MM_COALESCE
+#define MM_COALESCE COALESCE_IMMEDIATE
+#endif
+
 // 바이트 단위 워드 사이즈, 더블 워드 사이즈
 #define WSIZE 4
 #define DSIZE 8
 
 // 힙의 사이즈를 2의 12승만큼 늘림
 #define CHUNKSIZE (1<<12)
-#define INITCHUNKSIZE (1<<6)
 
-// 가용 연결 리스트의 개수 (최대값)
+// 가용 연결 리스트의 개수, seglist는 크기 구간마다 하나
+#if MM_LIST == LIST_SEGLIST
 #define LISTLIMIT 20
+#else
+#define LISTLIMIT 1
+#endif
 
 #define MAX(x,y) ((x)>(y) ? (x) : (y))
 
@@ -73,59 +116,88 @@ team_t team = {
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-// P가 가르키는 곳을 PTR로 변경
-#define SET_PTR(p, ptr) (*(unsigned int *)(p) = (unsigned int)(ptr))
+// 가용 블록의 링크는 힙 시작 주소로부터의 오프셋(1워드)으로 저장, 0은 NULL
+// 포인터 크기와 상관없이 최소 블록(2*DSIZE) 안에 링크 두 개가 들어감
+#define GET_LINK(p) (GET(p) ? heap_base + GET(p) : NULL)
+#define SET_PTR(p, ptr) PUT(p, (ptr) ? (unsigned int)((char *)(ptr) - heap_base) : 0)
 
 // 가용 블럭 리스트에서 이전, 이후 블록 포인터를 반환
 #define NEXT_PTR(ptr) ((char *)(ptr))
 #define PREV_PTR(ptr) ((char *)(ptr) + WSIZE)
 
 // 분리되어 있는 가용 리스트 내에서 이전, 이후 블록 포인터를 반환
-#define NEXT(ptr) (*(char **)(ptr))
-#define PREV(ptr) (*(char **)(PREV_PTR(ptr)))
+#define NEXT(ptr) GET_LINK(NEXT_PTR(ptr))
+#define PREV(ptr) GET_LINK(PREV_PTR(ptr))
 
 // Jiwon Parameter & Function
 char *heap_listp = 0;
-void *free_list[LISTLIMIT];
+static char *heap_base;
+#if MM_LIST != LIST_IMPLICIT
+static char *free_list[LISTLIMIT];
+#endif
+#if MM_FIT == FIT_NEXT
+// 다음 검색을 시작할 블록, implicit은 힙의 블록, 그 외에는 리스트마다 리스트 안의 블록
+static char *rover[LISTLIMIT];
+#endif
 
-static void *coalesce(void *bp);
 static void *extend_heap(size_t words);
+static void *coalesce(void *bp);
+#if MM_COALESCE == COALESCE_DEFERRED
+static int coalesce_all(void);
+#endif
 static void *find_fit(size_t asize);
 static void place(void *bp, size_t asize);
 static void insert_block(void *ptr, size_t size);
 static void delete_block(void *ptr);
 
-/* 
+// 블록 사이즈에 해당하는 가용 리스트 번호
+static inline int list_index(size_t size) {
+#if MM_LIST == LIST_SEGLIST
+    int class = 31 - __builtin_clz((unsigned int)size);
+
+    return (class < LISTLIMIT - 1) ? class : LISTLIMIT - 1;
+#else
+    return 0;
+#endif
+}
+
+/*
  * mm_init - initialize the malloc package.
  */
 int mm_init(void) {
-    // 전체 free list 초기화 단계
-    for (int class = 0; class < LISTLIMIT; class++) {
-        free_list[class] = NULL;
-    }
-    
     if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1) {
         return -1;
     }
-    
+    heap_base = heap_listp;
+
     // 패딩(0), 프롤로그 H/F(1), 에필로그 H 생성(0)
     PUT(heap_listp, 0);
     PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1));
     PUT(heap_listp + (3*WSIZE), PACK(0, 1));
-    
+
     // 프롤로그 F로 위치, 앞이나 뒤 블록으로 가기 위해
     heap_listp += (2*WSIZE);
 
+    // 전체 free list 초기화 단계
+    for (int class = 0; class < LISTLIMIT; class++) {
+#if MM_LIST != LIST_IMPLICIT
+        free_list[class] = NULL;
+#endif
+#if MM_FIT == FIT_NEXT
+        rover[class] = (MM_LIST == LIST_IMPLICIT) ? heap_listp : NULL;
+#endif
+    }
+
     // extend_heap 함수는 워드 단위임
-    if (extend_heap(INITCHUNKSIZE) == NULL) {
+    if (extend_heap(CHUNKSIZE/WSIZE) == NULL) {
         return -1;
     }
 
     return 0;
 }
 
-/* 
+/*
  * mm_malloc - Allocate a block by incrementing the brk pointer.
  *     Always allocate a block whose size is a multiple of the alignment.
  */
@@ -149,13 +221,21 @@ void *mm_malloc(size_t size) {
         // (DSIZE-1)는 8의 배수로 만들어주기 위한 코드, int 연산은 소수점 버림
         asize = DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
     }
-    
+
     // 가용 블록 검색 후 요청한 블록 배치 (검색 -> 배치)
     if ((bp = find_fit(asize)) != NULL) {
         place(bp, asize);
         return bp;
     }
 
+#if MM_COALESCE == COALESCE_DEFERRED
+    // 미뤄둔 통합을 한 번에 하고 다시 검색 (검색 -> 통합 -> 검색 -> 배치)
+    if (coalesce_all() && (bp = find_fit(asize)) != NULL) {
+        place(bp, asize);
+        return bp;
+    }
+#endif
+
     // 알맞은 가용 블록이 없을 경우 확장 후 블록 배치 (검색 -> 확장 -> 배치)
     extendsize = MAX(asize, CHUNKSIZE);
     if ((bp = extend_heap(extendsize/WSIZE)) == NULL) {
@@ -178,7 +258,12 @@ void mm_free(void *ptr) {
     PUT(HDRP(ptr), PACK(size, 0));
     PUT(FTRP(ptr), PACK(size, 0));
 
+#if MM_COALESCE == COALESCE_DEFERRED
+    // 통합은 coalesce_all에서 한 번에
+    insert_block(ptr, size);
+#else
     coalesce(ptr);
+#endif
 }
 
 /*
@@ -188,13 +273,14 @@ void *mm_realloc(void *ptr, size_t size) {
     void *oldptr = ptr;
     void *newptr;
     size_t copySize;
-    
+
     newptr = mm_malloc(size);
     if (newptr == NULL) {
         return NULL;
     }
 
-    copySize = GET_SIZE(HDRP(oldptr));
+    // 기존 payload(H, F 제외)만큼만 복사
+    copySize = GET_SIZE(HDRP(oldptr)) - DSIZE;
 
     // 기존 사이즈가 요청 사이즈보다 크면, 기존 사이즈 갱신
     if (size < copySize) {
@@ -209,6 +295,17 @@ void *mm_realloc(void *ptr, size_t size) {
     return newptr;
 }
 
+/*
+ * mm_heapwalk - 힙의 블록을 주소 순서대로 visit에 넘김 (mdriver -F)
+ */
+void mm_heapwalk(void (*visit)(void *bp, size_t size, int alloc)) {
+    char *bp;
+
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+        visit(bp, GET_SIZE(HDRP(bp)), GET_ALLOC(HDRP(bp)));
+    }
+}
+
 // Jiwon Parameter & Function
 
 // 1) 힙이 초기화될 때: 초기화 후 초기 가용 블록을 생성하기 위해 호출
@@ -231,6 +328,7 @@ static void *extend_heap(size_t words) {
     // 에필로그는 새로 만든 블록의 다음 블록
 	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
 
+    // 통합을 미루는 경우에도 힙 끝의 가용 블록과는 바로 합쳐 큰 블록을 만듦
 	return coalesce(bp);
 }
 
@@ -272,45 +370,195 @@ static void *coalesce(void *bp) {
         // 이전 블록의 payload를 보도록 함
         bp = PREV_BLKP(bp);
     }
-    
+
+#if MM_LIST == LIST_IMPLICIT && MM_FIT == FIT_NEXT
+    // 통합된 블록 안쪽을 가리키게 된 rover는 통합된 블록의 시작으로
+    if (rover[0] > (char *)bp && rover[0] < NEXT_BLKP(bp)) {
+        rover[0] = bp;
+    }
+#endif
+
     insert_block(bp, size);
 
     return bp;
 }
 
+#if MM_COALESCE == COALESCE_DEFERRED
+// 힙을 처음부터 훑으며 이어진 가용 블록들을 하나로 통합, 통합한 블록이 있으면 1
+static int coalesce_all(void) {
+    char *bp;
+    char *next;
+    size_t size;
+    int merged = 0;
+
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+        if (GET_ALLOC(HDRP(bp)) || GET_ALLOC(HDRP(NEXT_BLKP(bp)))) {
+            continue;
+        }
+
+        // 에필로그는 할당 상태이므로 힙 끝에서 멈춤
+        delete_block(bp);
+        size = GET_SIZE(HDRP(bp));
+        while (!GET_ALLOC(HDRP(next = NEXT_BLKP(bp)))) {
+            delete_block(next);
+            size += GET_SIZE(HDRP(next));
+            PUT(HDRP(bp), PACK(size, 0));
+            PUT(FTRP(bp), PACK(size, 0));
+        }
+
+#if MM_LIST == LIST_IMPLICIT && MM_FIT == FIT_NEXT
+        if (rover[0] > bp && rover[0] < NEXT_BLKP(bp)) {
+            rover[0] = bp;
+        }
+#endif
+        insert_block(bp, size);
+        merged = 1;
+    }
+
+    return merged;
+}
+#endif
+
+#if MM_LIST == LIST_IMPLICIT
+// 가용 블록 검색: 힙의 블록을 순서대로
 static void *find_fit(size_t asize) {
     char *bp;
+#if MM_FIT == FIT_NEXT
+    // 이전 검색이 끝난 지점부터 에필로그까지, 리턴되지 않을 경우 처음부터 그 지점까지
+    for (bp = rover[0]; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+        if (!GET_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(bp)) >= asize) {
+            rover[0] = bp;
+            return bp;
+        }
+    }
 
-    int class = 0;
-    size_t target = asize;
+    for (bp = NEXT_BLKP(heap_listp); bp < rover[0]; bp = NEXT_BLKP(bp)) {
+        if (!GET_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(bp)) >= asize) {
+            rover[0] = bp;
+            return bp;
+        }
+    }
 
-    // 분리 가용 리스트에서 가용 리스트 검색
-    while (class < LISTLIMIT) {
-        // 1) 마지막 클래스거나,
-        // 2) target이 1보다 작거나 같고 가용 리스트 값이 널이 아닐 때,
-        if ((class == LISTLIMIT - 1) || ((target <= 1) && (free_list[class] != NULL))) {
-            bp = free_list[class];
+    return NULL;
+#else
+    char *best = NULL;
+
+    // H 사이즈가 0보다 클 때까지, 즉 에필로그까지 검색한단 의미
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+        // 가용 상태이고, 요청한 사이즈만큼 충분한 공간이 있을 때
+        if (GET_ALLOC(HDRP(bp)) || GET_SIZE(HDRP(bp)) < asize) {
+            continue;
+        }
+        if (MM_FIT == FIT_FIRST || GET_SIZE(HDRP(bp)) == asize) {
+            return bp;
+        }
+        if (best == NULL || GET_SIZE(HDRP(bp)) < GET_SIZE(HDRP(best))) {
+            best = bp;
+        }
+    }
+
+    return best;
+#endif
+}
+
+// implicit은 가용 리스트가 없음
+static void insert_block(void *ptr, size_t size) {
+}
+
+static void delete_block(void *ptr) {
+}
+#else
+// 가용 블록 검색: asize가 속한 리스트부터 큰 리스트 순서로
+// 위 리스트의 블록은 모두 아래 리스트의 블록보다 크므로 한 리스트에서 찾으면 멈춤
+static void *find_fit(size_t asize) {
+    char *bp;
+
+    for (int class = list_index(asize); class < LISTLIMIT; class++) {
+#if MM_FIT == FIT_NEXT
+        // 이전 검색이 끝난 블록부터 리스트 끝까지, 리턴되지 않을 경우 처음부터 그 블록까지
+        char *start = (rover[class] != NULL) ? rover[class] : free_list[class];
+
+        for (bp = start; bp != NULL; bp = NEXT(bp)) {
+            if (GET_SIZE(HDRP(bp)) >= asize) {
+                rover[class] = bp;
+                return bp;
+            }
+        }
 
-            // 가용 상태이고, 요청한 사이즈만큼 충분한 공간이 있을 때
-            while ((bp != NULL) && ((asize > GET_SIZE(HDRP(bp))))) {
-                bp = NEXT(bp);
+        for (bp = free_list[class]; bp != start; bp = NEXT(bp)) {
+            if (GET_SIZE(HDRP(bp)) >= asize) {
+                rover[class] = bp;
+                return bp;
             }
+        }
+#else
+        char *best = NULL;
 
-            if (bp != NULL) {
+        for (bp = free_list[class]; bp != NULL; bp = NEXT(bp)) {
+            if (GET_SIZE(HDRP(bp)) < asize) {
+                continue;
+            }
+            if (MM_FIT == FIT_FIRST || GET_SIZE(HDRP(bp)) == asize) {
                 return bp;
             }
+            if (best == NULL || GET_SIZE(HDRP(bp)) < GET_SIZE(HDRP(best))) {
+                best = bp;
+            }
         }
-        
-        target >>= 1;
 
-        class++;
+        if (best != NULL) {
+            return best;
+        }
+#endif
     }
 
     return NULL;
 }
 
+// 가용 리스트의 맨 앞에 삽입 (LIFO)
+static void insert_block(void *ptr, size_t size) {
+    int class = list_index(size);
+    char *head = free_list[class];
+
+    SET_PTR(NEXT_PTR(ptr), head);
+    SET_PTR(PREV_PTR(ptr), NULL);
+
+    if (head != NULL) {
+        SET_PTR(PREV_PTR(head), ptr);
+    }
+
+    free_list[class] = ptr;
+}
+
+static void delete_block(void *ptr) {
+    int class = list_index(GET_SIZE(HDRP(ptr)));
+    char *next = NEXT(ptr);
+    char *prev = PREV(ptr);
+
+#if MM_FIT == FIT_NEXT
+    // 빠지는 블록을 가리키던 rover는 다음 블록으로
+    if (rover[class] == ptr) {
+        rover[class] = next;
+    }
+#endif
+
+    if (next != NULL) {
+        SET_PTR(PREV_PTR(next), prev);
+    }
+
+    // 1) 가운데나 맨 마지막 원소일 때, 이전 블록이 다음 블록을 가리킴
+    if (prev != NULL) {
+        SET_PTR(NEXT_PTR(prev), next);
+
+    // 2) 맨 처음 원소일 때, 가용 리스트의 시작 위치를 다음 블록으로 갱신
+    } else {
+        free_list[class] = next;
+    }
+}
+#endif
+
 // 맞는 블록이 있으면 배치하고, 남으면 가용 블록으로 분할
-static void place(void *bp, size_t asize){
+static void place(void *bp, size_t asize) {
     // asize: 요청한 블록 사이즈
     // csize: 가용 블록 사이즈
     size_t csize = GET_SIZE(HDRP(bp));
@@ -326,7 +574,7 @@ static void place(void *bp, size_t asize){
         PUT(HDRP(bp), PACK(csize - asize, 0));
         PUT(FTRP(bp), PACK(csize - asize, 0));
 
-        insert_block(bp,(csize-asize));
+        insert_block(bp, (csize - asize));
 
     // 2) 분할하지 않아도 될 때: 남은 블록이 2*DSIZE보다 작으면 데이터를 담을 수 없음
     } else {
@@ -334,102 +582,3 @@ static void place(void *bp, size_t asize){
         PUT(FTRP(bp), PACK(csize, 1));
     }
 }
-
-static void insert_block(void *ptr, size_t size) {
-    int class = 0;
-
-    // search_ptr: 노드 자리를 검색해나감, insert_ptr: 실제 노드가 삽입되는 위치
-    void *search_ptr = ptr; 
-    void *insert_ptr = NULL; 
-    
-    // 분리 가용 리스트 중에서 적절한 것을 선택함
-    while ((class < LISTLIMIT - 1) && (size > 1)) {
-        size >>= 1;
-        class++;
-    }
-    
-    // 크기가 작은 것부터 검색함
-    // 분리 가용 리스트의 시작 위치를 search_ptr에 저장
-    search_ptr = free_list[class];
-    while ((search_ptr != NULL) && (size > GET_SIZE(HDRP(search_ptr)))) {
-        insert_ptr = search_ptr;
-        search_ptr = NEXT(search_ptr);
-    }
-    
-    if (search_ptr != NULL) {
-        // 1) 분리 가용 리스트의 가운데로 삽입할 때,
-        if (insert_ptr != NULL) {
-            SET_PTR(NEXT_PTR(ptr), search_ptr);
-            SET_PTR(PREV_PTR(search_ptr), ptr);
-            SET_PTR(PREV_PTR(ptr), insert_ptr);
-            SET_PTR(NEXT_PTR(insert_ptr), ptr);
-
-        // 2) 분리 가용 리스트의 맨 처음에 삽입할 때,
-        } else {
-            SET_PTR(NEXT_PTR(ptr), search_ptr);
-            SET_PTR(PREV_PTR(search_ptr), ptr);
-            SET_PTR(PREV_PTR(ptr), NULL);
-            
-            // 분리 가용 리스트의 시작 위치를 search_ptr에 저장
-            free_list[class] = ptr;
-        }
-
-    } else {
-        // 3) 분리 가용 리스트의 맨 마지막에 삽입할 때,
-        if (insert_ptr != NULL) {
-            SET_PTR(NEXT_PTR(ptr), NULL);
-            SET_PTR(PREV_PTR(ptr), insert_ptr);
-            SET_PTR(NEXT_PTR(insert_ptr), ptr);
-
-        // 4) 분리 가용 리스트에 원소가 없을 때,
-        } else {
-            SET_PTR(NEXT_PTR(ptr), NULL);
-            SET_PTR(PREV_PTR(ptr), NULL);
-            
-            // 분리 가용 리스트의 시작 위치를 search_ptr에 저장
-            free_list[class] = ptr;
-        }
-    }
-    
-    return;
-}
-
-static void delete_block(void *ptr) {
-    size_t size = GET_SIZE(HDRP(ptr));
-
-    int list = 0;
-    
-    // 분리 가용 리스트 중에서 적절한 것을 선택함
-    while ((list < LISTLIMIT - 1) && (size > 1)) {
-        size >>= 1;
-        list++;
-    }
-    
-    if (NEXT(ptr) != NULL) { 
-        // 1) 분리 가용 리스트의 가운데로 삽입할 때,
-        if (PREV(ptr) != NULL) {
-            SET_PTR(PREV_PTR(NEXT(ptr)), PREV(ptr));
-            SET_PTR(NEXT_PTR(PREV(ptr)), NEXT(ptr));
-
-        // 2) 분리 가용 리스트의 맨 처음에 삽입할 때,
-        } else {
-            SET_PTR(PREV_PTR(NEXT(ptr)), NULL);
-
-            // 분리 가용 리스트의 시작 위치를 다음 블록으로 갱신
-            free_list[list] = NEXT(ptr);
-        }
-    } else {
-        // 3) 분리 가용 리스트의 맨 마지막에 삽입할 때,
-        if (PREV(ptr) != NULL) {
-            SET_PTR(NEXT_PTR(PREV(ptr)), NULL);
-
-        // 4) 분리 가용 리스트의 마지막 원소일 때,
-        } else {
-
-            // 분리 가용 리스트의 시작 위치를 Null로 갱신
-            free_list[list] = NULL;
-        }
-    }
-    
-    return;
-}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#!/bin/sh
+#
+# policy-report.sh - Compare several mdriver builds trace by trace
+#
+# usage: ./policy-report.sh <driver>...  (run from the malloc_lab directory)
+#
+# Runs each driver on the default tracefiles and prints its utilization
+# and throughput for every trace, the best driver for each trace, and
+# the drivers ranked by performance index. "mdriver" is listed as mm.c,
+# "mdriver-<policy>" as <policy>.
+#
+
+if [ $# -eq 0 ]; then
+    echo "usage: $0 <driver>..." >&2
+    exit 1
+fi
+
+out=$(mktemp -d) || exit 1
+trap 'rm -rf "$out"' EXIT
+
+n=0
+for d in "$@"; do
+    n=$((n + 1))
+    echo "running $d" >&2
+    ./"$d" -V > "$out/$n.$d" 2>&1
+done
+
+# The files are read in run order, so driver i is the i-th file.
+ls "$out" | sort -n | sed "s|^|$out/|" | xargs awk '
+FNR == 1 {
+    nd++
+    name = FILENAME
+    sub(/.*\/[0-9]+\./, "", name)
+    sub(/^mdriver-?/, "", name)
+    drv[nd] = (name == "") ? "mm.c" : name
+    if (length(drv[nd]) > namew) namew = length(drv[nd])
+    nt = 0
+}
+/^Reading tracefile:/ {
+    trace[++nt] = $3
+    sub(/-bal\.rep$|\.rep$/, "", trace[nt])
+}
+/^ *[0-9]+ +(yes|no) / {
+    t = $1 + 1
+    util[nd, t] = ($2 == "yes") ? $3 + 0 : -1
+    kops[nd, t] = ($2 == "yes") ? last_kops(6) : -1
+    if (t > ntr) ntr = t
+}
+/^Total/ { util[nd, "total"] = $2 + 0; kops[nd, "total"] = last_kops(5) }
+/^Perf index/ { perf[nd] = $NF + 0 }
+
+# mdriver prints secs as %10.6f and Kops as %6.0f with no space between,
+# so a Kops value of 6 digits or more is glued to the secs field.
+function last_kops(f) {
+    if (NF >= f) return $f + 0
+    return substr($(f - 1), index($(f - 1), ".") + 7) + 0
+}
+
+function cell(v, w) {
+    return sprintf("%" w "s", (v < 0 || v == "") ? "-" : v)
+}
+
+function table(title, val,    i, t, w, line) {
+    printf "%s\n%-" namew "s", title, ""
+    for (t = 1; t <= ntr; t++) {
+        w[t] = (length(trace[t]) > 6 ? length(trace[t]) : 6) + 1
+        printf "%" w[t] "s", trace[t]
+    }
+    printf "%8s\n", "total"
+    for (i = 1; i <= nd; i++) {
+        line = sprintf("%-" namew "s", drv[i])
+        for (t = 1; t <= ntr; t++) {
+            line = line cell(val[i, t], w[t])
+        }
+        print line cell(val[i, "total"], 8)
+    }
+    print ""
+}
+
+function best(val, t,    i, b) {
+    b = 0
+    for (i = 1; i <= nd; i++) {
+        if (val[i, t] >= 0 && val[i, t] != "" && (b == 0 || val[i, t] > val[b, t])) b = i
+    }
+    return b
+}
+
+END {
+    namew += 2
+    table("Utilization (%)", util)
+    table("Throughput (Kops)", kops)
+
+    printf "Best per trace\n%-12s %-" namew + 8 "s %s\n", "trace", "utilization", "throughput"
+    for (t = 1; t <= ntr; t++) {
+        bu = best(util, t)
+        bk = best(kops, t)
+        printf "%-12s %-" namew + 8 "s %s\n", trace[t],
+            bu ? drv[bu] " (" util[bu, t] "%)" : "-",
+            bk ? drv[bk] " (" kops[bk, t] " Kops)" : "-"
+    }
+    print ""
+
+    # Rank by performance index (selection sort, few drivers)
+    for (i = 1; i <= nd; i++) order[i] = i
+    for (i = 1; i <= nd; i++) {
+        for (j = i + 1; j <= nd; j++) {
+            if (perf[order[j]] > perf[order[i]]) {
+                k = order[i]; order[i] = order[j]; order[j] = k
+            }
+        }
+    }
+    printf "Ranking\n%-" namew "s %6s %8s %6s\n", "", "util", "Kops", "perf"
+    for (i = 1; i <= nd; i++) {
+        k = order[i]
+        printf "%-" namew "s %5s%% %8s %6s\n", drv[k], util[k, "total"],
+            kops[k, "total"], (k in perf) ? perf[k] : "-"
+    }
+}'
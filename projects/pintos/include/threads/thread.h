@@ -5,6 +5,7 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/fixed_point.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -108,6 +109,11 @@ struct thread {
 	struct list donations;
 	struct list_elem donation_elem;
 
+	// MLFQS 관련 파라미터들
+	int nice;
+	fixed_t recent_cpu;
+	struct list_elem all_elem;          /* all_list 원소, 매 초 recent_cpu 갱신용 */
+
 	// System Call 관련 파라미터들
 	int exit_status;
 	struct intr_frame parent_if;
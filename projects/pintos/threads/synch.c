@@ -199,8 +199,8 @@ lock_acquire (struct lock *lock) {
 
 	struct thread *curr = thread_current();
 
-	// 해당 lock의 holder가 존재하는지 확인
-	if (lock->holder != NULL) {
+	// 해당 lock의 holder가 존재하는지 확인, MLFQS에서는 우선순위 기부를 하지 않음
+	if (lock->holder != NULL && !thread_mlfqs) {
 		// 현재 스레드의 wait_on_lock 변수에 기다리는 lock의 주소 저장
 		curr->wait_on_lock = lock;
 
@@ -248,8 +248,10 @@ lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-	remove_with_lock(lock);
-	refresh_priority();
+	if (!thread_mlfqs) {
+		remove_with_lock(lock);
+		refresh_priority();
+	}
 
 	lock->holder = NULL;
 	sema_up (&lock->semaphore);
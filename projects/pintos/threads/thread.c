@@ -11,6 +11,7 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -29,7 +30,16 @@
 
 /* List of processes in THREAD_READY state, that is, processes
    that are ready to run but not actually running. */
-static struct list ready_list;
+// 우선순위마다 FIFO 큐 하나씩, ready_bitmap의 i번째 비트는 ready_list[i]가 비어 있지 않음을 뜻함
+// 가장 높은 우선순위는 비트 연산 한 번으로 찾으므로 넣고 빼는 데 스레드 수와 상관없이 O(1)
+#define PRI_LEVELS (PRI_MAX - PRI_MIN + 1)
+static struct list ready_list[PRI_LEVELS];
+static uint64_t ready_bitmap;
+static int ready_count;                 /* ready_list 전체의 스레드 수 */
+
+// MLFQS: 살아 있는 모든 스레드, recent_cpu는 block된 스레드도 매 초 줄어들어야 함
+static struct list all_list;
+static fixed_t load_avg;
 
 static struct list sleep_list;
 int64_t min_time_in_sleep;
@@ -70,6 +80,11 @@ static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_update_second (void);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -117,7 +132,9 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
+	for (int i = 0; i < PRI_LEVELS; i++)
+		list_init (&ready_list[i]);
+	ready_bitmap = 0;
 	list_init (&destruction_req);
 
 	list_init(&sleep_list);
@@ -125,6 +142,9 @@ thread_init (void) {
 
 	list_init (&wait_list);
 
+	list_init (&all_list);
+	load_avg = 0;
+
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
@@ -164,6 +184,22 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	/* MLFQS: 실행 중인 스레드만 recent_cpu가 늘어나므로 4 tick마다는 그 스레드의
+	   우선순위만 다시 계산하고, 모든 스레드의 값이 바뀌는 매 초에만 전체를 갱신함 */
+	if (thread_mlfqs) {
+		int64_t ticks = timer_ticks ();
+
+		if (t != idle_thread)
+			t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+		if (ticks % TIMER_FREQ == 0)
+			mlfqs_update_second ();
+		if (ticks % TIME_SLICE == 0 && t != idle_thread) {
+			mlfqs_update_priority (t);
+			if (t->priority < ready_max_priority ())
+				intr_yield_on_return ();
+		}
+	}
+
 	/* Enforce preemption. */
 	if (++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
@@ -286,7 +322,10 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list , &t->elem, &cmp_priority, NULL);
+	// block된 동안 바뀐 recent_cpu는 매 초 반영되지만 우선순위는 ready 큐에 들어올 때 계산함
+	if (thread_mlfqs && t != idle_thread)
+		mlfqs_update_priority (t);
+	ready_push(t);
 	t->status = THREAD_READY;
 	intr_set_level (old_level);
 }
@@ -334,6 +373,7 @@ thread_exit (void) {
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	list_remove (&thread_current ()->all_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -349,7 +389,7 @@ thread_yield (void) {
 
 	old_level = intr_disable ();
 	if (curr != idle_thread) {
-		list_insert_ordered(&ready_list, &curr->elem, &cmp_priority, NULL);
+		ready_push(curr);
 	}
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
@@ -358,6 +398,10 @@ thread_yield (void) {
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
+	// MLFQS에서는 스케줄러가 우선순위를 정하므로 무시함
+	if (thread_mlfqs)
+		return;
+
 	thread_current ()->init_priority = new_priority;
 
 	refresh_priority();
@@ -372,29 +416,94 @@ thread_get_priority (void) {
 
 /* Sets the current thread's nice value to NICE. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	curr->nice = nice;
+	if (thread_mlfqs)
+		mlfqs_update_priority (curr);
+
+	intr_set_level (old_level);
+
+	// 우선순위가 낮아졌으면 더 높은 ready 스레드에게 양보
+	test_max_priority ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int nice = thread_current ()->nice;
+	intr_set_level (old_level);
+
+	return nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int value = fp_to_int_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+
+	return value;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int value = fp_to_int_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	intr_set_level (old_level);
+
+	return value;
+}
+
+// mlfqs_update_priority: priority = PRI_MAX - (recent_cpu / 4) - (nice * 2), PRI_MIN..PRI_MAX로 자름
+// ready 큐에 있는 스레드는 우선순위가 바뀌면 새 큐의 맨 뒤로 옮김, 인터럽트가 꺼진 상태에서 호출해야 함
+static void
+mlfqs_update_priority (struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4)) - t->nice * 2;
+
+	priority = MAX(PRI_MIN, MIN(PRI_MAX, priority));
+	if (priority == t->priority)
+		return;
+
+	if (t->status == THREAD_READY) {
+		ready_remove (t);
+		t->priority = priority;
+		ready_push (t);
+	} else {
+		t->priority = priority;
+	}
+}
+
+// mlfqs_update_second: 매 초 load_avg와 모든 스레드의 recent_cpu를 갱신
+// 우선순위도 모든 스레드에 대해 다시 계산함, block된 스레드도 sema_up과 cond_signal이 waiters를 우선순위로 정렬할 때 쓰므로 빠뜨리면 안 됨
+static void
+mlfqs_update_second (void) {
+	struct thread *curr = thread_current ();
+	int ready_threads = ready_count + (curr != idle_thread ? 1 : 0);
+
+	// load_avg = (59/60) * load_avg + (1/60) * ready_threads
+	load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+			fp_div_int (int_to_fp (ready_threads), 60));
+
+	// recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
+	fixed_t twice_load = fp_mul_int (load_avg, 2);
+	fixed_t decay = fp_div (twice_load, fp_add_int (twice_load, 1));
+
+	for (struct list_elem *e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, all_elem);
+
+		if (t == idle_thread)
+			continue;
+
+		t->recent_cpu = fp_add_int (fp_mul (decay, t->recent_cpu), t->nice);
+		mlfqs_update_priority (t);
+	}
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -465,6 +574,22 @@ init_thread (struct thread *t, const char *name, int priority) {
 	list_init(&t->donations);
 	t->wait_on_lock = NULL;
 
+	// MLFQS: 처음 스레드는 0, 나머지는 부모의 nice와 recent_cpu를 물려받고 우선순위는 그 값으로 계산
+	if (t != running_thread ()) {
+		struct thread *parent = running_thread ();
+		t->nice = parent->nice;
+		t->recent_cpu = parent->recent_cpu;
+	}
+	if (thread_mlfqs) {
+		mlfqs_update_priority (t);
+		t->init_priority = t->priority;
+	}
+
+	// 타이머 인터럽트가 매 초 all_list를 순회하므로 인터럽트를 끄고 넣음
+	enum intr_level old_level = intr_disable ();
+	list_push_back (&all_list, &t->all_elem);
+	intr_set_level (old_level);
+
 	// System Call 관련 인자들을 초기화 시켜줌
 	list_init(&t->child_list);
     sema_init(&t->wait_sema, 0);
@@ -482,10 +607,46 @@ init_thread (struct thread *t, const char *name, int priority) {
    idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
+	int priority = ready_max_priority();
+
+	if (priority < PRI_MIN)
 		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+	struct list *queue = &ready_list[priority - PRI_MIN];
+	struct thread *t = list_entry (list_pop_front (queue), struct thread, elem);
+	ready_count--;
+	if (list_empty(queue)) {
+		ready_bitmap &= ~(1ULL << (priority - PRI_MIN));
+	}
+	return t;
+}
+
+// ready_push: 스레드를 자기 우선순위 큐의 맨 뒤에 넣음, 같은 우선순위끼리는 들어온 순서대로 실행됨
+static void
+ready_push (struct thread *t) {
+	list_push_back(&ready_list[t->priority - PRI_MIN], &t->elem);
+	ready_bitmap |= 1ULL << (t->priority - PRI_MIN);
+	ready_count++;
+}
+
+// ready_remove: ready 상태인 스레드를 큐에서 뺌, 우선순위가 바뀌어 다른 큐로 옮길 때 사용
+static void
+ready_remove (struct thread *t) {
+	list_remove(&t->elem);
+	ready_count--;
+	if (list_empty(&ready_list[t->priority - PRI_MIN])) {
+		ready_bitmap &= ~(1ULL << (t->priority - PRI_MIN));
+	}
+}
+
+// ready_max_priority: ready 스레드 중 가장 높은 우선순위, 없으면 PRI_MIN - 1
+static int
+ready_max_priority (void) {
+	if (ready_bitmap == 0)
+		return PRI_MIN - 1;
+
+	// 가장 높은 비트 = 가장 높은 우선순위
+	return PRI_MIN + 63 - __builtin_clzll(ready_bitmap);
 }
 
 /* Use iretq to launch the thread */
@@ -729,15 +890,11 @@ bool cmp_priority (const struct list_elem *a,
 
 // test_max_priority: 현재 스레드와 우선순위가 가장 높은 스레드를 비교하여 스케줄링
 void test_max_priority(){
-	if (list_empty(&ready_list) || intr_context()) {
+	if (intr_context()) {
 		return;
 	}
-    
-	int run_priority = thread_current()->priority;
-	struct list_elem *e= list_begin(&ready_list);
-	struct thread *t = list_entry(e, struct thread, elem);
-    
-	if (run_priority < t->priority) {
+
+	if (thread_current()->priority < ready_max_priority()) {
 		thread_yield();
 	}
 }
@@ -758,7 +915,17 @@ void donate_priority() {
 		}
 
 		curr = curr->wait_on_lock->holder;
-		curr->priority = original_priority;
+
+		// ready 상태인 스레드는 우선순위에 맞는 큐로 옮겨야 함, 큐를 건드리는 동안 인터럽트를 끔
+		enum intr_level old_level = intr_disable ();
+		if (curr->status == THREAD_READY) {
+			ready_remove(curr);
+			curr->priority = original_priority;
+			ready_push(curr);
+		} else {
+			curr->priority = original_priority;
+		}
+		intr_set_level (old_level);
 	}
 }
 
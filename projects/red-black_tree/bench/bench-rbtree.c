@@ -0,0 +1,741 @@
+#include <bptree.h>
+#include <math.h>
+#include <rbtree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Throughput of rbtree and bptree against other ordered multisets of int keys.
+//
+// For every structure, key stream and size the benchmark inserts n keys
+// from the stream, finds them all, scans the whole structure in order and
+// erases them all, and reports ns per operation and the peak memory the
+// structure added to the process. Each case runs in its own child process
+// so that one case's heap does not show up in the next one's peak.
+//
+// usage: bench-rbtree [max_n]   (sizes 10^3 .. max_n, default 10^7)
+
+#define MIN_N 1000
+#define DEFAULT_MAX_N 10000000
+#define ZIPF_THETA 0.99
+
+// Sorted array insert and erase move O(n) keys, so they are only timed
+// up to this size; above it the array is loaded with one sort instead.
+#define SORTED_MAX_INSERT 100000
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t xorshift64(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Resident set size or its high-water mark in KB, -1 without /proc
+static long proc_status_kb(const char *field) {
+  char line[256];
+  long kb = -1;
+  size_t len = strlen(field);
+  FILE *fp = fopen("/proc/self/status", "r");
+
+  if (fp == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (strncmp(line, field, len) == 0 && line[len] == ':') {
+      kb = strtol(line + len + 1, NULL, 10);
+      break;
+    }
+  }
+  fclose(fp);
+  return kb;
+}
+
+static int comp(const void *p1, const void *p2) {
+  const key_t e1 = *(const key_t *)p1;
+  const key_t e2 = *(const key_t *)p2;
+  return (e1 > e2) - (e1 < e2);
+}
+
+/*
+ * Key streams
+ */
+
+// Spread ranks over the key space so that neighbouring ranks are not
+// neighbouring keys; multiplying by an odd constant is a bijection.
+static key_t scramble(uint64_t rank) {
+  return (key_t)(((uint32_t)rank * 2654435761u) >> 1);
+}
+
+static void stream_seq(key_t *keys, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)i;
+  }
+}
+
+static void stream_random(key_t *keys, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(xorshift64() >> 33);
+  }
+}
+
+// Zipf over n ranks (Gray et al., "Quickly generating billion-record
+// synthetic databases"): a few keys take most of the stream, so the
+// structures hold many duplicates and lookups hit a hot working set.
+static void stream_zipf(key_t *keys, const size_t n) {
+  double zetan = 0, zeta2 = 1 + pow(0.5, ZIPF_THETA);
+  for (size_t i = 1; i <= n; i++) {
+    zetan += 1 / pow((double)i, ZIPF_THETA);
+  }
+  double alpha = 1 / (1 - ZIPF_THETA);
+  double eta = (1 - pow(2.0 / n, 1 - ZIPF_THETA)) / (1 - zeta2 / zetan);
+
+  for (size_t i = 0; i < n; i++) {
+    double u = (double)(xorshift64() >> 11) / (double)(1ULL << 53);
+    double uz = u * zetan;
+    uint64_t rank;
+    if (uz < 1) {
+      rank = 0;
+    } else if (uz < zeta2) {
+      rank = 1;
+    } else {
+      rank = (uint64_t)(n * pow(eta * u - eta + 1, alpha));
+    }
+    keys[i] = scramble(rank);
+  }
+}
+
+typedef struct {
+  const char *name;
+  void (*fill)(key_t *, const size_t);
+} stream_t;
+
+static const stream_t streams[] = {
+    {"seq", stream_seq},
+    {"random", stream_random},
+    {"zipf", stream_zipf},
+};
+
+/*
+ * Structures under test. Every one is a multiset, like rbtree.
+ */
+
+typedef struct {
+  const char *name;
+  void *(*create)(void);
+  void (*destroy)(void *);
+  void (*insert)(void *, const key_t);
+  int (*find)(void *, const key_t);
+  void (*erase)(void *, const key_t);
+  long long (*scan)(void *);                           // sum of all keys
+  void (*load)(void *, const key_t *, const size_t);  // NULL: insert one by one
+  size_t max_insert;                                  // 0: no limit
+} ds_t;
+
+// rbtree from src/
+
+static void *rb_create(void) { return new_rbtree(); }
+static void rb_destroy(void *t) { delete_rbtree(t); }
+static void rb_insert(void *t, const key_t key) { rbtree_insert(t, key); }
+static int rb_find(void *t, const key_t key) { return rbtree_find(t, key) != NULL; }
+
+static void rb_erase(void *t, const key_t key) {
+  node_t *p = rbtree_find(t, key);
+  if (p != NULL) {
+    rbtree_erase(t, p);
+  }
+}
+
+static long long rb_scan(void *t) {
+  long long sum = 0;
+  const rbtree *tree = t;
+  if (tree->root == tree->nil) {
+    return 0;
+  }
+  for (node_t *p = rbtree_min(tree); p != NULL; p = rbtree_next(tree, p)) {
+    sum += p->key;
+  }
+  return sum;
+}
+
+// bptree from src/
+
+static void *bp_create(void) { return new_bptree(); }
+static void bp_destroy(void *t) { delete_bptree(t); }
+static void bp_insert(void *t, const key_t key) { bptree_insert(t, key); }
+static int bp_find(void *t, const key_t key) { return bptree_find(t, key); }
+static void bp_erase(void *t, const key_t key) { bptree_erase(t, key); }
+
+static int bp_add(key_t key, void *arg) {
+  *(long long *)arg += key;
+  return 0;
+}
+
+static long long bp_scan(void *t) {
+  long long sum = 0;
+  bptree_range(t, -2147483647 - 1, 2147483647, bp_add, &sum);
+  return sum;
+}
+
+// B-tree (CLRS, minimum degree BT_T). Leaves are allocated without the
+// child array, since a node never changes between leaf and internal.
+
+#define BT_T 16
+
+typedef struct bt_node {
+  int n, leaf;
+  key_t keys[2 * BT_T - 1];
+  struct bt_node *child[];  // 2 * BT_T, internal nodes only
+} bt_node;
+
+typedef struct {
+  bt_node *root;
+} btree;
+
+static bt_node *bt_new_node(const int leaf) {
+  size_t size = sizeof(bt_node) + (leaf ? 0 : 2 * BT_T * sizeof(bt_node *));
+  bt_node *x = malloc(size);
+  x->n = 0;
+  x->leaf = leaf;
+  return x;
+}
+
+static void *bt_create(void) {
+  btree *t = malloc(sizeof(btree));
+  t->root = bt_new_node(1);
+  return t;
+}
+
+static void bt_free(bt_node *x) {
+  if (!x->leaf) {
+    for (int i = 0; i <= x->n; i++) {
+      bt_free(x->child[i]);
+    }
+  }
+  free(x);
+}
+
+static void bt_destroy(void *t) {
+  bt_free(((btree *)t)->root);
+  free(t);
+}
+
+// first index whose key is >= key (or > key when upper)
+static int bt_bound(const bt_node *x, const key_t key, const int upper) {
+  int lo = 0, hi = x->n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (x->keys[mid] < key || (upper && x->keys[mid] == key)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static int bt_find(void *t, const key_t key) {
+  const bt_node *x = ((btree *)t)->root;
+  for (;;) {
+    int i = bt_bound(x, key, 0);
+    if (i < x->n && x->keys[i] == key) {
+      return 1;
+    }
+    if (x->leaf) {
+      return 0;
+    }
+    x = x->child[i];
+  }
+}
+
+// split the full child i of x around its middle key
+static void bt_split_child(bt_node *x, const int i) {
+  bt_node *y = x->child[i];
+  bt_node *z = bt_new_node(y->leaf);
+
+  z->n = BT_T - 1;
+  memcpy(z->keys, y->keys + BT_T, (BT_T - 1) * sizeof(key_t));
+  if (!y->leaf) {
+    memcpy(z->child, y->child + BT_T, BT_T * sizeof(bt_node *));
+  }
+  y->n = BT_T - 1;
+
+  memmove(x->child + i + 2, x->child + i + 1, (x->n - i) * sizeof(bt_node *));
+  x->child[i + 1] = z;
+  memmove(x->keys + i + 1, x->keys + i, (x->n - i) * sizeof(key_t));
+  x->keys[i] = y->keys[BT_T - 1];
+  x->n++;
+}
+
+static void bt_insert(void *t, const key_t key) {
+  btree *tree = t;
+  bt_node *x = tree->root;
+
+  if (x->n == 2 * BT_T - 1) {
+    bt_node *s = bt_new_node(0);
+    s->child[0] = x;
+    tree->root = s;
+    bt_split_child(s, 0);
+    x = s;
+  }
+
+  // split full children on the way down so that a leaf always has room
+  while (!x->leaf) {
+    int i = bt_bound(x, key, 1);
+    if (x->child[i]->n == 2 * BT_T - 1) {
+      bt_split_child(x, i);
+      if (key >= x->keys[i]) {
+        i++;
+      }
+    }
+    x = x->child[i];
+  }
+
+  int i = bt_bound(x, key, 1);
+  memmove(x->keys + i + 1, x->keys + i, (x->n - i) * sizeof(key_t));
+  x->keys[i] = key;
+  x->n++;
+}
+
+// merge child i + 1 and key i of x into child i
+static void bt_merge(bt_node *x, const int i) {
+  bt_node *y = x->child[i];
+  bt_node *z = x->child[i + 1];
+
+  y->keys[BT_T - 1] = x->keys[i];
+  memcpy(y->keys + BT_T, z->keys, z->n * sizeof(key_t));
+  if (!y->leaf) {
+    memcpy(y->child + BT_T, z->child, (z->n + 1) * sizeof(bt_node *));
+  }
+  y->n = 2 * BT_T - 1;
+
+  memmove(x->keys + i, x->keys + i + 1, (x->n - i - 1) * sizeof(key_t));
+  memmove(x->child + i + 1, x->child + i + 2, (x->n - i - 1) * sizeof(bt_node *));
+  x->n--;
+  free(z);
+}
+
+// make sure child i of x has at least BT_T keys before descending into it,
+// returns the index of the child to descend into
+static int bt_fill_child(bt_node *x, int i) {
+  bt_node *c = x->child[i];
+
+  if (c->n >= BT_T) {
+    return i;
+  }
+
+  if (i > 0 && x->child[i - 1]->n >= BT_T) {
+    // borrow through x from the left sibling
+    bt_node *l = x->child[i - 1];
+    memmove(c->keys + 1, c->keys, c->n * sizeof(key_t));
+    if (!c->leaf) {
+      memmove(c->child + 1, c->child, (c->n + 1) * sizeof(bt_node *));
+      c->child[0] = l->child[l->n];
+    }
+    c->keys[0] = x->keys[i - 1];
+    x->keys[i - 1] = l->keys[l->n - 1];
+    l->n--;
+    c->n++;
+  } else if (i < x->n && x->child[i + 1]->n >= BT_T) {
+    // borrow through x from the right sibling
+    bt_node *r = x->child[i + 1];
+    c->keys[c->n] = x->keys[i];
+    if (!c->leaf) {
+      c->child[c->n + 1] = r->child[0];
+      memmove(r->child, r->child + 1, r->n * sizeof(bt_node *));
+    }
+    x->keys[i] = r->keys[0];
+    memmove(r->keys, r->keys + 1, (r->n - 1) * sizeof(key_t));
+    r->n--;
+    c->n++;
+  } else if (i < x->n) {
+    bt_merge(x, i);
+  } else {
+    bt_merge(x, i - 1);
+    i--;
+  }
+
+  return i;
+}
+
+static void bt_erase(void *t, const key_t key) {
+  btree *tree = t;
+  bt_node *x = tree->root;
+  key_t k = key;
+
+  for (;;) {
+    int i = bt_bound(x, k, 0);
+
+    if (i < x->n && x->keys[i] == k) {
+      if (x->leaf) {
+        memmove(x->keys + i, x->keys + i + 1, (x->n - i - 1) * sizeof(key_t));
+        x->n--;
+        break;
+      }
+      if (x->child[i]->n >= BT_T) {
+        // replace with the predecessor and delete that from the left
+        bt_node *y = x->child[i];
+        while (!y->leaf) {
+          y = y->child[y->n];
+        }
+        k = x->keys[i] = y->keys[y->n - 1];
+        x = x->child[i];
+      } else if (x->child[i + 1]->n >= BT_T) {
+        bt_node *y = x->child[i + 1];
+        while (!y->leaf) {
+          y = y->child[0];
+        }
+        k = x->keys[i] = y->keys[0];
+        x = x->child[i + 1];
+      } else {
+        bt_merge(x, i);
+        x = x->child[i];
+      }
+    } else {
+      if (x->leaf) {
+        break;
+      }
+      x = x->child[bt_fill_child(x, i)];
+    }
+  }
+
+  if (tree->root->n == 0 && !tree->root->leaf) {
+    bt_node *old = tree->root;
+    tree->root = old->child[0];
+    free(old);
+  }
+}
+
+static long long bt_scan_node(const bt_node *x) {
+  long long sum = 0;
+  for (int i = 0; i < x->n; i++) {
+    if (!x->leaf) {
+      sum += bt_scan_node(x->child[i]);
+    }
+    sum += x->keys[i];
+  }
+  if (!x->leaf) {
+    sum += bt_scan_node(x->child[x->n]);
+  }
+  return sum;
+}
+
+static long long bt_scan(void *t) { return bt_scan_node(((btree *)t)->root); }
+
+// Skip list with p = 1/4
+
+#define SL_MAX_LEVEL 16
+
+typedef struct sl_node {
+  key_t key;
+  struct sl_node *next[];
+} sl_node;
+
+typedef struct {
+  sl_node *head;
+  int level;
+} skiplist;
+
+static void *sl_create(void) {
+  skiplist *s = malloc(sizeof(skiplist));
+  s->head = calloc(1, sizeof(sl_node) + SL_MAX_LEVEL * sizeof(sl_node *));
+  s->level = 1;
+  return s;
+}
+
+static void sl_destroy(void *t) {
+  skiplist *s = t;
+  sl_node *x = s->head;
+  while (x != NULL) {
+    sl_node *next = x->next[0];
+    free(x);
+    x = next;
+  }
+  free(s);
+}
+
+// last node with a key below key, on every level
+static void sl_search(skiplist *s, const key_t key, sl_node **update) {
+  sl_node *x = s->head;
+  for (int l = s->level - 1; l >= 0; l--) {
+    while (x->next[l] != NULL && x->next[l]->key < key) {
+      x = x->next[l];
+    }
+    update[l] = x;
+  }
+}
+
+static void sl_insert(void *t, const key_t key) {
+  skiplist *s = t;
+  sl_node *update[SL_MAX_LEVEL];
+  int level = 1;
+
+  while (level < SL_MAX_LEVEL && (xorshift64() & 3) == 0) {
+    level++;
+  }
+  sl_search(s, key, update);
+  for (; s->level < level; s->level++) {
+    update[s->level] = s->head;
+  }
+
+  sl_node *x = malloc(sizeof(sl_node) + level * sizeof(sl_node *));
+  x->key = key;
+  for (int l = 0; l < level; l++) {
+    x->next[l] = update[l]->next[l];
+    update[l]->next[l] = x;
+  }
+}
+
+static int sl_find(void *t, const key_t key) {
+  skiplist *s = t;
+  sl_node *x = s->head;
+  for (int l = s->level - 1; l >= 0; l--) {
+    while (x->next[l] != NULL && x->next[l]->key < key) {
+      x = x->next[l];
+    }
+  }
+  x = x->next[0];
+  return x != NULL && x->key == key;
+}
+
+static void sl_erase(void *t, const key_t key) {
+  skiplist *s = t;
+  sl_node *update[SL_MAX_LEVEL] = {NULL};
+
+  sl_search(s, key, update);
+  sl_node *x = update[0]->next[0];
+  if (x == NULL || x->key != key) {
+    return;
+  }
+  for (int l = 0; l < s->level && update[l]->next[l] == x; l++) {
+    update[l]->next[l] = x->next[l];
+  }
+  free(x);
+}
+
+static long long sl_scan(void *t) {
+  long long sum = 0;
+  for (sl_node *x = ((skiplist *)t)->head->next[0]; x != NULL; x = x->next[0]) {
+    sum += x->key;
+  }
+  return sum;
+}
+
+// Sorted array
+
+typedef struct {
+  key_t *a;
+  size_t n, cap;
+} sorted_array;
+
+static void *sa_create(void) { return calloc(1, sizeof(sorted_array)); }
+
+static void sa_destroy(void *t) {
+  free(((sorted_array *)t)->a);
+  free(t);
+}
+
+static size_t sa_bound(const sorted_array *s, const key_t key, const int upper) {
+  size_t lo = 0, hi = s->n;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (s->a[mid] < key || (upper && s->a[mid] == key)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static void sa_reserve(sorted_array *s, const size_t n) {
+  if (n > s->cap) {
+    s->cap = (n > 2 * s->cap) ? n : 2 * s->cap;
+    s->a = realloc(s->a, s->cap * sizeof(key_t));
+  }
+}
+
+static void sa_insert(void *t, const key_t key) {
+  sorted_array *s = t;
+  sa_reserve(s, s->n + 1);
+  size_t i = sa_bound(s, key, 1);
+  memmove(s->a + i + 1, s->a + i, (s->n - i) * sizeof(key_t));
+  s->a[i] = key;
+  s->n++;
+}
+
+static int sa_find(void *t, const key_t key) {
+  sorted_array *s = t;
+  size_t i = sa_bound(s, key, 0);
+  return i < s->n && s->a[i] == key;
+}
+
+static void sa_erase(void *t, const key_t key) {
+  sorted_array *s = t;
+  size_t i = sa_bound(s, key, 0);
+  if (i < s->n && s->a[i] == key) {
+    memmove(s->a + i, s->a + i + 1, (s->n - i - 1) * sizeof(key_t));
+    s->n--;
+  }
+}
+
+static long long sa_scan(void *t) {
+  sorted_array *s = t;
+  long long sum = 0;
+  for (size_t i = 0; i < s->n; i++) {
+    sum += s->a[i];
+  }
+  return sum;
+}
+
+static void sa_load(void *t, const key_t *keys, const size_t n) {
+  sorted_array *s = t;
+  sa_reserve(s, n);
+  memcpy(s->a, keys, n * sizeof(key_t));
+  qsort(s->a, n, sizeof(key_t), comp);
+  s->n = n;
+}
+
+static const ds_t structures[] = {
+    {"rbtree", rb_create, rb_destroy, rb_insert, rb_find, rb_erase, rb_scan, NULL, 0},
+    {"bptree", bp_create, bp_destroy, bp_insert, bp_find, bp_erase, bp_scan, NULL, 0},
+    {"btree", bt_create, bt_destroy, bt_insert, bt_find, bt_erase, bt_scan, NULL, 0},
+    {"skiplist", sl_create, sl_destroy, sl_insert, sl_find, sl_erase, sl_scan, NULL, 0},
+    {"sorted", sa_create, sa_destroy, sa_insert, sa_find, sa_erase, sa_scan, sa_load,
+     SORTED_MAX_INSERT},
+};
+
+/*
+ * Driver
+ */
+
+static void print_ns(const double secs, const size_t ops) {
+  if (secs < 0) {
+    printf(" %9s", "-");
+  } else {
+    printf(" %9.1f", secs / ops * 1e9);
+  }
+}
+
+// Run one case and print its row; called in a child process.
+static void run_case(const ds_t *ds, const stream_t *st, const size_t n) {
+  key_t *keys = malloc(n * sizeof(key_t));
+  long long expect = 0;
+  double t0, t_insert = -1, t_find, t_scan, t_erase = -1;
+  const int timed = (ds->max_insert == 0 || n <= ds->max_insert);
+
+  st->fill(keys, n);
+  for (size_t i = 0; i < n; i++) {
+    expect += keys[i];
+  }
+
+  long base_kb = proc_status_kb("VmRSS");
+  void *t = ds->create();
+
+  if (timed) {
+    t0 = now();
+    for (size_t i = 0; i < n; i++) {
+      ds->insert(t, keys[i]);
+    }
+    t_insert = now() - t0;
+  } else {
+    ds->load(t, keys, n);
+  }
+
+  size_t missed = 0;
+  t0 = now();
+  for (size_t i = 0; i < n; i++) {
+    missed += !ds->find(t, keys[i]);
+  }
+  t_find = now() - t0;
+
+  t0 = now();
+  long long sum = ds->scan(t);
+  t_scan = now() - t0;
+
+  long peak_kb = proc_status_kb("VmHWM");
+
+  if (timed) {
+    t0 = now();
+    for (size_t i = 0; i < n; i++) {
+      ds->erase(t, keys[i]);
+    }
+    t_erase = now() - t0;
+    if (ds->scan(t) != 0) {
+      fprintf(stderr, "%s: keys left after erasing every key\n", ds->name);
+      exit(1);
+    }
+  }
+
+  if (missed != 0 || sum != expect) {
+    fprintf(stderr, "%s: %zu keys not found, scan sum %lld != %lld\n", ds->name, missed, sum,
+            expect);
+    exit(1);
+  }
+
+  printf("%-9s %-7s %9zu", ds->name, st->name, n);
+  print_ns(t_insert, n);
+  print_ns(t_find, n);
+  print_ns(t_erase, n);
+  print_ns(t_scan, n);
+  if (base_kb < 0 || peak_kb < 0) {
+    printf(" %9s\n", "-");
+  } else {
+    printf(" %9.1f\n", (peak_kb - base_kb) / 1024.0);
+  }
+
+  ds->destroy(t);
+  free(keys);
+}
+
+int main(int argc, char *argv[]) {
+  size_t max_n = DEFAULT_MAX_N;
+
+  if (argc > 2 || (argc == 2 && (max_n = strtoul(argv[1], NULL, 10)) < MIN_N)) {
+    fprintf(stderr, "usage: %s [max_n >= %d]\n", argv[0], MIN_N);
+    return 1;
+  }
+
+  printf("ns/op for insert, find, erase and per key for scan; peak memory in MB\n");
+  printf("%-9s %-7s %9s %9s %9s %9s %9s %9s\n", "struct", "stream", "n", "insert", "find",
+         "erase", "scan", "peak_MB");
+
+  for (size_t n = MIN_N; n <= max_n; n *= 10) {
+    for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); s++) {
+      for (size_t d = 0; d < sizeof(structures) / sizeof(structures[0]); d++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+          perror("fork");
+          return 1;
+        }
+        if (pid == 0) {
+          rng_state += n * 31 + s;  // the same keys for every structure
+          run_case(&structures[d], &streams[s], n);
+          fflush(stdout);
+          _exit(0);
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          fprintf(stderr, "%s on %s at n = %zu failed\n", structures[d].name, streams[s].name, n);
+          return 1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
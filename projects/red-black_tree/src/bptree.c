@@ -0,0 +1,455 @@
+#include "bptree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// 노드 하나는 캐시 라인 4개, key를 앞쪽에 모아 두어 노드 안 탐색은 key가 있는 라인만 읽음
+#define CACHE_LINE 64
+#define NODE_SIZE (4 * CACHE_LINE)
+
+// 가득 찬 노드를 반으로 나누었을 때 양쪽이 최소 개수 이상이 되도록
+#define LEAF_MAX 60
+#define LEAF_MIN (LEAF_MAX / 2)
+#define INNER_MAX 20
+#define INNER_MIN ((INNER_MAX - 1) / 2)
+
+// 같은 key가 여러 개일 수 있으므로 separator는 양쪽 모두 포함하는 경계:
+// child[i]의 key <= keys[i] <= child[i + 1]의 key
+typedef struct leaf_t {
+  struct leaf_t *next;  // key 순서로 다음 leaf, range scan용
+  int n;
+  key_t keys[LEAF_MAX];
+} leaf_t;
+
+typedef struct {
+  int n;
+  key_t keys[INNER_MAX];
+  void *child[INNER_MAX + 1];
+} inner_t;
+
+_Static_assert(sizeof(leaf_t) <= NODE_SIZE, "leaf_t does not fit in a node");
+_Static_assert(sizeof(inner_t) <= NODE_SIZE, "inner_t does not fit in a node");
+// SIMD 탐색은 key 배열 끝에서 4개 단위로 읽으므로 배열 길이가 4의 배수여야 함
+_Static_assert(LEAF_MAX % 4 == 0 && INNER_MAX % 4 == 0, "key arrays must be a multiple of 4");
+
+// Jiwon Functions
+
+static void *node_new(void);
+static void free_node(void *x, int h);
+static int count_below(const key_t *keys, const int n, const key_t key, const int upper);
+static leaf_t *lower_bound(const bptree *t, const key_t key, int *pos);
+static int node_full(void *x, int h);
+static int split_child(inner_t *in, int i, int h);
+static int erase_rec(void *x, int h, const key_t key);
+static void fix_child(inner_t *in, int i, int h);
+static void remove_child(inner_t *in, int i);
+
+// B+ tree 구조체 생성, 처음엔 빈 leaf 하나가 root
+bptree *new_bptree(void) {
+  bptree *t = (bptree *)calloc(1, sizeof(bptree));
+  if (t == NULL) {
+    return NULL;
+  }
+
+  t->root = node_new();
+  if (t->root == NULL) {
+    free(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+void delete_bptree(bptree *t) {
+  free_node(t->root, t->height);
+  free(t);
+}
+
+// key 추가, 메모리가 부족하면 -1 반환
+// 내려가면서 가득 찬 자식을 미리 나누어 두므로 도착한 leaf에는 항상 자리가 있음
+int bptree_insert(bptree *t, const key_t key) {
+  if (node_full(t->root, t->height)) {
+    inner_t *r = node_new();
+    if (r == NULL) {
+      return -1;
+    }
+    r->child[0] = t->root;
+    if (split_child(r, 0, t->height) < 0) {
+      free(r);
+      return -1;
+    }
+    t->root = r;
+    t->height++;
+  }
+
+  void *x = t->root;
+  for (int h = t->height; h > 0; h--) {
+    inner_t *in = x;
+    int i = count_below(in->keys, in->n, key, 1);
+
+    if (node_full(in->child[i], h - 1)) {
+      if (split_child(in, i, h - 1) < 0) {
+        return -1;
+      }
+      if (key >= in->keys[i]) {
+        i++;
+      }
+    }
+    x = in->child[i];
+  }
+
+  leaf_t *leaf = x;
+  int pos = count_below(leaf->keys, leaf->n, key, 1);
+  memmove(leaf->keys + pos + 1, leaf->keys + pos, (leaf->n - pos) * sizeof(key_t));
+  leaf->keys[pos] = key;
+  leaf->n++;
+  t->size++;
+
+  return 0;
+}
+
+// key가 있으면 1, 없으면 0
+int bptree_find(const bptree *t, const key_t key) {
+  int pos;
+  leaf_t *leaf = lower_bound(t, key, &pos);
+
+  return leaf != NULL && leaf->keys[pos] == key;
+}
+
+// 가장 작은 key를 *out에 저장하고 1 반환, 빈 tree면 0
+int bptree_min(const bptree *t, key_t *out) {
+  void *x = t->root;
+
+  for (int h = t->height; h > 0; h--) {
+    x = ((inner_t *)x)->child[0];
+  }
+
+  leaf_t *leaf = x;
+  if (leaf->n == 0) {
+    return 0;
+  }
+  *out = leaf->keys[0];
+  return 1;
+}
+
+// 가장 큰 key를 *out에 저장하고 1 반환, 빈 tree면 0
+int bptree_max(const bptree *t, key_t *out) {
+  void *x = t->root;
+
+  for (int h = t->height; h > 0; h--) {
+    inner_t *in = x;
+    x = in->child[in->n];
+  }
+
+  leaf_t *leaf = x;
+  if (leaf->n == 0) {
+    return 0;
+  }
+  *out = leaf->keys[leaf->n - 1];
+  return 1;
+}
+
+// key 하나 삭제, 없으면 -1 반환
+int bptree_erase(bptree *t, const key_t key) {
+  if (!erase_rec(t->root, t->height, key)) {
+    return -1;
+  }
+  t->size--;
+
+  // root가 key를 모두 잃으면 하나 남은 자식이 root가 됨
+  if (t->height > 0 && ((inner_t *)t->root)->n == 0) {
+    inner_t *old = t->root;
+    t->root = old->child[0];
+    t->height--;
+    free(old);
+  }
+
+  return 0;
+}
+
+// key 순서대로 최대 n개를 array로 변환, leaf 연결을 따라감
+int bptree_to_array(const bptree *t, key_t *arr, const size_t n) {
+  void *x = t->root;
+  size_t i = 0;
+
+  for (int h = t->height; h > 0; h--) {
+    x = ((inner_t *)x)->child[0];
+  }
+
+  for (leaf_t *leaf = x; leaf != NULL && i < n; leaf = leaf->next) {
+    size_t m = (size_t)leaf->n < n - i ? (size_t)leaf->n : n - i;
+    memcpy(arr + i, leaf->keys, m * sizeof(key_t));
+    i += m;
+  }
+
+  return 0;
+}
+
+// lo 이상 hi 이하인 key를 순서대로 visit에 넘기고 방문한 개수 반환
+// visit이 0이 아닌 값을 반환하면 그 key까지 세고 멈춤
+size_t bptree_range(const bptree *t, const key_t lo, const key_t hi,
+                    int (*visit)(key_t, void *), void *arg) {
+  int pos;
+  size_t count = 0;
+
+  for (leaf_t *leaf = lower_bound(t, lo, &pos); leaf != NULL; leaf = leaf->next, pos = 0) {
+    for (; pos < leaf->n; pos++) {
+      if (leaf->keys[pos] > hi) {
+        return count;
+      }
+      count++;
+      if (visit(leaf->keys[pos], arg) != 0) {
+        return count;
+      }
+    }
+  }
+
+  return count;
+}
+
+// Jiwon Functions
+
+// 캐시 라인에 맞춰 정렬된 빈 노드
+static void *node_new(void) {
+  void *x = aligned_alloc(CACHE_LINE, NODE_SIZE);
+
+  if (x != NULL) {
+    memset(x, 0, NODE_SIZE);
+  }
+  return x;
+}
+
+static void free_node(void *x, int h) {
+  if (h > 0) {
+    inner_t *in = x;
+    for (int i = 0; i <= in->n; i++) {
+      free_node(in->child[i], h - 1);
+    }
+  }
+  free(x);
+}
+
+// 정렬된 keys[0..n) 중 key보다 작은 (upper면 key 이하인) key의 개수
+// 분기 없이 4개씩 비교해서 세므로 노드 안에서는 이진 탐색보다 빠름
+static int count_below(const key_t *keys, const int n, const key_t key, const int upper) {
+  int count = 0;
+
+#ifdef __SSE2__
+  _Static_assert(sizeof(key_t) == 4, "SIMD search expects 32-bit keys");
+  const __m128i k = _mm_set1_epi32(key);
+
+  for (int i = 0; i < n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(keys + i));
+    int bits;
+
+    if (upper) {
+      bits = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k))) & 0xf;
+    } else {
+      bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k)));
+    }
+    // n을 넘는 칸은 세지 않음
+    if (n - i < 4) {
+      bits &= (1 << (n - i)) - 1;
+    }
+    count += __builtin_popcount(bits);
+  }
+#else
+  while (count < n && (keys[count] < key || (upper && keys[count] == key))) {
+    count++;
+  }
+#endif
+
+  return count;
+}
+
+// key 이상인 첫 key의 leaf를 반환하고 위치를 *pos에 저장, 없으면 NULL
+static leaf_t *lower_bound(const bptree *t, const key_t key, int *pos) {
+  void *x = t->root;
+
+  for (int h = t->height; h > 0; h--) {
+    inner_t *in = x;
+    x = in->child[count_below(in->keys, in->n, key, 0)];
+  }
+
+  leaf_t *leaf = x;
+  int i = count_below(leaf->keys, leaf->n, key, 0);
+
+  // 이 leaf의 key가 모두 작으면 다음 leaf의 첫 key가 답
+  if (i == leaf->n) {
+    leaf = leaf->next;
+    i = 0;
+  }
+
+  *pos = i;
+  return leaf;
+}
+
+static int node_full(void *x, int h) {
+  return (h == 0) ? ((leaf_t *)x)->n == LEAF_MAX : ((inner_t *)x)->n == INNER_MAX;
+}
+
+// 높이 h인 가득 찬 자식 in->child[i]를 둘로 나누고 경계 key를 in에 넣음
+// leaf는 오른쪽 첫 key를 복사해 올리고, inner 노드는 가운데 key를 올려 보냄
+static int split_child(inner_t *in, int i, int h) {
+  key_t sep;
+  void *right = node_new();
+
+  if (right == NULL) {
+    return -1;
+  }
+
+  if (h == 0) {
+    leaf_t *c = in->child[i];
+    leaf_t *r = right;
+    int m = LEAF_MAX / 2;
+
+    r->n = c->n - m;
+    memcpy(r->keys, c->keys + m, r->n * sizeof(key_t));
+    c->n = m;
+    r->next = c->next;
+    c->next = r;
+    sep = r->keys[0];
+  } else {
+    inner_t *c = in->child[i];
+    inner_t *r = right;
+    int m = INNER_MAX / 2;
+
+    sep = c->keys[m];
+    r->n = c->n - m - 1;
+    memcpy(r->keys, c->keys + m + 1, r->n * sizeof(key_t));
+    memcpy(r->child, c->child + m + 1, (r->n + 1) * sizeof(void *));
+    c->n = m;
+  }
+
+  memmove(in->keys + i + 1, in->keys + i, (in->n - i) * sizeof(key_t));
+  memmove(in->child + i + 2, in->child + i + 1, (in->n - i) * sizeof(void *));
+  in->keys[i] = sep;
+  in->child[i + 1] = right;
+  in->n++;
+
+  return 0;
+}
+
+// 높이 h인 노드 X 아래에서 key 하나를 지우면 1, 없으면 0
+// 부모가 돌아오면서 모자란 자식을 채우므로 X 자신은 최소 개수보다 하나 적어질 수 있음
+static int erase_rec(void *x, int h, const key_t key) {
+  if (h == 0) {
+    leaf_t *leaf = x;
+    int pos = count_below(leaf->keys, leaf->n, key, 0);
+
+    if (pos == leaf->n || leaf->keys[pos] != key) {
+      return 0;
+    }
+    memmove(leaf->keys + pos, leaf->keys + pos + 1, (leaf->n - pos - 1) * sizeof(key_t));
+    leaf->n--;
+    return 1;
+  }
+
+  // separator가 key와 같으면 오른쪽 자식에도 같은 key가 있을 수 있음
+  inner_t *in = x;
+  for (int i = count_below(in->keys, in->n, key, 0); i <= in->n; i++) {
+    if (erase_rec(in->child[i], h - 1, key)) {
+      fix_child(in, i, h - 1);
+      return 1;
+    }
+    if (i == in->n || in->keys[i] != key) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+// 높이 h인 in->child[i]가 최소 개수보다 적으면 형제에게서 빌리거나 형제와 합침
+// in은 key가 하나 이상 있으므로 형제가 적어도 하나 있음
+static void fix_child(inner_t *in, int i, int h) {
+  if (h == 0) {
+    leaf_t *c = in->child[i];
+    leaf_t *l = (i > 0) ? in->child[i - 1] : NULL;
+    leaf_t *r = (i < in->n) ? in->child[i + 1] : NULL;
+
+    if (c->n >= LEAF_MIN) {
+      return;
+    }
+
+    if (l != NULL && l->n > LEAF_MIN) {
+      // 왼쪽 형제의 마지막 key를 가져오고 경계를 그 key로
+      memmove(c->keys + 1, c->keys, c->n * sizeof(key_t));
+      c->keys[0] = l->keys[--l->n];
+      c->n++;
+      in->keys[i - 1] = c->keys[0];
+    } else if (r != NULL && r->n > LEAF_MIN) {
+      // 오른쪽 형제의 첫 key를 가져오고 경계를 형제의 새 첫 key로
+      c->keys[c->n++] = r->keys[0];
+      r->n--;
+      memmove(r->keys, r->keys + 1, r->n * sizeof(key_t));
+      in->keys[i] = r->keys[0];
+    } else if (l != NULL) {
+      memcpy(l->keys + l->n, c->keys, c->n * sizeof(key_t));
+      l->n += c->n;
+      l->next = c->next;
+      free(c);
+      remove_child(in, i - 1);
+    } else {
+      memcpy(c->keys + c->n, r->keys, r->n * sizeof(key_t));
+      c->n += r->n;
+      c->next = r->next;
+      free(r);
+      remove_child(in, i);
+    }
+    return;
+  }
+
+  inner_t *c = in->child[i];
+  inner_t *l = (i > 0) ? in->child[i - 1] : NULL;
+  inner_t *r = (i < in->n) ? in->child[i + 1] : NULL;
+
+  if (c->n >= INNER_MIN) {
+    return;
+  }
+
+  if (l != NULL && l->n > INNER_MIN) {
+    // 경계 key가 내려오고 왼쪽 형제의 마지막 key가 경계로 올라감
+    memmove(c->keys + 1, c->keys, c->n * sizeof(key_t));
+    memmove(c->child + 1, c->child, (c->n + 1) * sizeof(void *));
+    c->keys[0] = in->keys[i - 1];
+    c->child[0] = l->child[l->n];
+    in->keys[i - 1] = l->keys[l->n - 1];
+    l->n--;
+    c->n++;
+  } else if (r != NULL && r->n > INNER_MIN) {
+    c->keys[c->n] = in->keys[i];
+    c->child[c->n + 1] = r->child[0];
+    in->keys[i] = r->keys[0];
+    memmove(r->keys, r->keys + 1, (r->n - 1) * sizeof(key_t));
+    memmove(r->child, r->child + 1, r->n * sizeof(void *));
+    r->n--;
+    c->n++;
+  } else if (l != NULL) {
+    // 경계 key를 사이에 두고 합침
+    l->keys[l->n] = in->keys[i - 1];
+    memcpy(l->keys + l->n + 1, c->keys, c->n * sizeof(key_t));
+    memcpy(l->child + l->n + 1, c->child, (c->n + 1) * sizeof(void *));
+    l->n += c->n + 1;
+    free(c);
+    remove_child(in, i - 1);
+  } else {
+    c->keys[c->n] = in->keys[i];
+    memcpy(c->keys + c->n + 1, r->keys, r->n * sizeof(key_t));
+    memcpy(c->child + c->n + 1, r->child, (r->n + 1) * sizeof(void *));
+    c->n += r->n + 1;
+    free(r);
+    remove_child(in, i);
+  }
+}
+
+// in->keys[i]와 그 오른쪽 자식 in->child[i + 1]을 뺌
+static void remove_child(inner_t *in, int i) {
+  memmove(in->keys + i, in->keys + i + 1, (in->n - i - 1) * sizeof(key_t));
+  memmove(in->child + i + 1, in->child + i + 2, (in->n - i - 1) * sizeof(void *));
+  in->n--;
+}
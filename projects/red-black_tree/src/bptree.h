@@ -0,0 +1,32 @@
+#ifndef _BPTREE_H_
+#define _BPTREE_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"  // key_t
+
+// B+ tree multiset of key_t with the operations of rbtree.h.
+// Nodes are four cache lines with the keys up front and searched with
+// SIMD; all keys live in the leaves, which are linked for range scans.
+// Keys move between nodes as the tree splits and merges, so the tree
+// hands out key values instead of node pointers.
+
+typedef struct {
+  void *root;
+  int height;  // 0 while the root is a leaf
+  size_t size;
+} bptree;
+
+bptree *new_bptree(void);
+void delete_bptree(bptree *);
+
+int bptree_insert(bptree *, const key_t);
+int bptree_find(const bptree *, const key_t);
+int bptree_min(const bptree *, key_t *);
+int bptree_max(const bptree *, key_t *);
+int bptree_erase(bptree *, const key_t);
+
+int bptree_to_array(const bptree *, key_t *, const size_t);
+size_t bptree_range(const bptree *, const key_t, const key_t, int (*)(key_t, void *), void *);
+
+#endif  // _BPTREE_H_
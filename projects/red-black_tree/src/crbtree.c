@@ -0,0 +1,409 @@
+#include "crbtree.h"
+
+#include <stdlib.h>
+
+// 노드 배열의 처음 크기, 이후 두 배씩 키움
+#define CNODE_INIT_CAP 64
+
+// 노드 배열 N의 X번 노드에 대한 접근
+#define PARENT(n, x) ((n)[x].parent_color >> 1)
+#define COLOR(n, x) ((color_t)((n)[x].parent_color & 1))
+#define SET_PARENT(n, x, p) ((n)[x].parent_color = ((uint32_t)(p) << 1) | ((n)[x].parent_color & 1))
+#define SET_COLOR(n, x, c) ((n)[x].parent_color = ((n)[x].parent_color & ~1u) | (c))
+
+// Jiwon Functions
+
+static uint32_t cnode_alloc(crbtree *t);
+static void left_rotate(crbtree *t, uint32_t x);
+static void right_rotate(crbtree *t, uint32_t x);
+static void insert_fixup(crbtree *t, uint32_t z);
+static void transplant(crbtree *t, uint32_t u, uint32_t v);
+static void delete_fixup(crbtree *t, uint32_t x);
+
+// Compact RB tree 구조체 생성
+// nodes[0]은 sentinel이며 BLACK (RBTREE_BLACK == 1)
+crbtree *new_crbtree(void) {
+  crbtree *t = (crbtree *)calloc(1, sizeof(crbtree));
+  if (t == NULL) {
+    return NULL;
+  }
+
+  t->nodes = (cnode_t *)calloc(CNODE_INIT_CAP, sizeof(cnode_t));
+  if (t->nodes == NULL) {
+    free(t);
+    return NULL;
+  }
+
+  t->cap = CNODE_INIT_CAP;
+  t->used = 1;
+  t->root = CRBTREE_NIL;
+  SET_COLOR(t->nodes, CRBTREE_NIL, RBTREE_BLACK);
+
+  return t;
+}
+
+// 노드 배열과 구조체만 반환하면 끝
+void delete_crbtree(crbtree *t) {
+  free(t->nodes);
+  free(t);
+}
+
+// key 추가 후 새 노드의 index 반환, 메모리가 부족하면 CRBTREE_NIL
+uint32_t crbtree_insert(crbtree *t, const key_t key) {
+  // 배열이 커지면 노드가 이동하므로 할당을 먼저 하고 배열 포인터를 가져옴
+  uint32_t z = cnode_alloc(t);
+  if (z == CRBTREE_NIL) {
+    return CRBTREE_NIL;
+  }
+
+  cnode_t *n = t->nodes;
+  uint32_t x = t->root;
+  uint32_t y = CRBTREE_NIL;
+
+  while (x != CRBTREE_NIL) {
+    y = x;
+    x = (key < n[x].key) ? n[x].left : n[x].right;
+  }
+
+  n[z].key = key;
+  n[z].left = CRBTREE_NIL;
+  n[z].right = CRBTREE_NIL;
+  n[z].parent_color = ((uint32_t)y << 1) | RBTREE_RED;
+
+  if (y == CRBTREE_NIL) {
+    t->root = z;
+  } else if (key < n[y].key) {
+    n[y].left = z;
+  } else {
+    n[y].right = z;
+  }
+
+  insert_fixup(t, z);
+
+  return z;
+}
+
+// key를 가진 노드의 index 반환, 없으면 CRBTREE_NIL
+uint32_t crbtree_find(const crbtree *t, const key_t key) {
+  const cnode_t *n = t->nodes;
+  uint32_t x = t->root;
+
+  while (x != CRBTREE_NIL) {
+    if (key < n[x].key) {
+      x = n[x].left;
+    } else if (key > n[x].key) {
+      x = n[x].right;
+    } else {
+      return x;
+    }
+  }
+
+  return CRBTREE_NIL;
+}
+
+// 최소값 노드의 index, 빈 tree면 CRBTREE_NIL
+uint32_t crbtree_min(const crbtree *t) {
+  const cnode_t *n = t->nodes;
+  uint32_t x = t->root;
+
+  if (x == CRBTREE_NIL) {
+    return CRBTREE_NIL;
+  }
+  while (n[x].left != CRBTREE_NIL) {
+    x = n[x].left;
+  }
+
+  return x;
+}
+
+// 최대값 노드의 index, 빈 tree면 CRBTREE_NIL
+uint32_t crbtree_max(const crbtree *t) {
+  const cnode_t *n = t->nodes;
+  uint32_t x = t->root;
+
+  if (x == CRBTREE_NIL) {
+    return CRBTREE_NIL;
+  }
+  while (n[x].right != CRBTREE_NIL) {
+    x = n[x].right;
+  }
+
+  return x;
+}
+
+// Z번 노드를 삭제하고 그 자리를 free list로 반환
+int crbtree_erase(crbtree *t, uint32_t z) {
+  cnode_t *n = t->nodes;
+  uint32_t y = z;
+  color_t y_original_color = COLOR(n, y);
+  uint32_t x;
+
+  if (n[z].left == CRBTREE_NIL) {
+    x = n[z].right;
+    transplant(t, z, n[z].right);
+  } else if (n[z].right == CRBTREE_NIL) {
+    x = n[z].left;
+    transplant(t, z, n[z].left);
+  } else {
+    // Z의 successor Y가 Z 자리로 이동
+    y = n[z].right;
+    while (n[y].left != CRBTREE_NIL) {
+      y = n[y].left;
+    }
+    y_original_color = COLOR(n, y);
+    x = n[y].right;
+
+    if (PARENT(n, y) == z) {
+      SET_PARENT(n, x, y);
+    } else {
+      transplant(t, y, n[y].right);
+      n[y].right = n[z].right;
+      SET_PARENT(n, n[y].right, y);
+    }
+
+    transplant(t, z, y);
+    n[y].left = n[z].left;
+    SET_PARENT(n, n[y].left, y);
+    SET_COLOR(n, y, COLOR(n, z));
+  }
+
+  if (y_original_color == RBTREE_BLACK) {
+    delete_fixup(t, x);
+  }
+
+  n[z].left = t->free_nodes;
+  t->free_nodes = z;
+
+  return 0;
+}
+
+// key 순서대로 최대 n개를 array로 변환
+// 부모 index를 따라 올라가므로 재귀나 스택이 필요 없음
+int crbtree_to_array(const crbtree *t, key_t *arr, const size_t n) {
+  const cnode_t *nd = t->nodes;
+  uint32_t x = crbtree_min(t);
+  size_t i = 0;
+
+  while (x != CRBTREE_NIL && i < n) {
+    arr[i++] = nd[x].key;
+
+    if (nd[x].right != CRBTREE_NIL) {
+      x = nd[x].right;
+      while (nd[x].left != CRBTREE_NIL) {
+        x = nd[x].left;
+      }
+    } else {
+      uint32_t p = PARENT(nd, x);
+      while (p != CRBTREE_NIL && x == nd[p].right) {
+        x = p;
+        p = PARENT(nd, p);
+      }
+      x = p;
+    }
+  }
+
+  return 0;
+}
+
+// Jiwon Functions
+
+// 빈 자리 하나 할당: free list를 먼저 쓰고, 배열이 다 차면 두 배로 늘림
+static uint32_t cnode_alloc(crbtree *t) {
+  uint32_t z = t->free_nodes;
+
+  if (z != CRBTREE_NIL) {
+    t->free_nodes = t->nodes[z].left;
+    return z;
+  }
+
+  if (t->used == t->cap) {
+    // parent link에서 한 비트를 색에 쓰므로 index는 31비트까지
+    if (t->cap > (UINT32_MAX >> 2)) {
+      return CRBTREE_NIL;
+    }
+
+    cnode_t *nodes = (cnode_t *)realloc(t->nodes, (size_t)t->cap * 2 * sizeof(cnode_t));
+    if (nodes == NULL) {
+      return CRBTREE_NIL;
+    }
+    t->nodes = nodes;
+    t->cap *= 2;
+  }
+
+  return t->used++;
+}
+
+static void left_rotate(crbtree *t, uint32_t x) {
+  cnode_t *n = t->nodes;
+  uint32_t y = n[x].right;
+  uint32_t p = PARENT(n, x);
+
+  n[x].right = n[y].left;
+  if (n[y].left != CRBTREE_NIL) {
+    SET_PARENT(n, n[y].left, x);
+  }
+  SET_PARENT(n, y, p);
+
+  if (p == CRBTREE_NIL) {
+    t->root = y;
+  } else if (x == n[p].left) {
+    n[p].left = y;
+  } else {
+    n[p].right = y;
+  }
+
+  n[y].left = x;
+  SET_PARENT(n, x, y);
+}
+
+static void right_rotate(crbtree *t, uint32_t x) {
+  cnode_t *n = t->nodes;
+  uint32_t y = n[x].left;
+  uint32_t p = PARENT(n, x);
+
+  n[x].left = n[y].right;
+  if (n[y].right != CRBTREE_NIL) {
+    SET_PARENT(n, n[y].right, x);
+  }
+  SET_PARENT(n, y, p);
+
+  if (p == CRBTREE_NIL) {
+    t->root = y;
+  } else if (x == n[p].right) {
+    n[p].right = y;
+  } else {
+    n[p].left = y;
+  }
+
+  n[y].right = x;
+  SET_PARENT(n, x, y);
+}
+
+// rbtree.c의 rbtree_insert_fixup과 같은 세 가지 경우
+static void insert_fixup(crbtree *t, uint32_t z) {
+  cnode_t *n = t->nodes;
+
+  while (COLOR(n, PARENT(n, z)) == RBTREE_RED) {
+    uint32_t p = PARENT(n, z);
+    uint32_t g = PARENT(n, p);
+
+    if (p == n[g].left) {
+      uint32_t y = n[g].right;
+
+      if (COLOR(n, y) == RBTREE_RED) {
+        SET_COLOR(n, p, RBTREE_BLACK);
+        SET_COLOR(n, y, RBTREE_BLACK);
+        SET_COLOR(n, g, RBTREE_RED);
+        z = g;
+      } else {
+        if (z == n[p].right) {
+          z = p;
+          left_rotate(t, z);
+          p = PARENT(n, z);
+        }
+        SET_COLOR(n, p, RBTREE_BLACK);
+        SET_COLOR(n, g, RBTREE_RED);
+        right_rotate(t, g);
+      }
+    } else {
+      uint32_t y = n[g].left;
+
+      if (COLOR(n, y) == RBTREE_RED) {
+        SET_COLOR(n, p, RBTREE_BLACK);
+        SET_COLOR(n, y, RBTREE_BLACK);
+        SET_COLOR(n, g, RBTREE_RED);
+        z = g;
+      } else {
+        if (z == n[p].left) {
+          z = p;
+          right_rotate(t, z);
+          p = PARENT(n, z);
+        }
+        SET_COLOR(n, p, RBTREE_BLACK);
+        SET_COLOR(n, g, RBTREE_RED);
+        left_rotate(t, g);
+      }
+    }
+  }
+
+  SET_COLOR(n, t->root, RBTREE_BLACK);
+}
+
+// V가 nil이어도 nodes[0]의 parent를 설정해 delete_fixup이 올라갈 수 있게 함
+static void transplant(crbtree *t, uint32_t u, uint32_t v) {
+  cnode_t *n = t->nodes;
+  uint32_t p = PARENT(n, u);
+
+  if (p == CRBTREE_NIL) {
+    t->root = v;
+  } else if (u == n[p].left) {
+    n[p].left = v;
+  } else {
+    n[p].right = v;
+  }
+
+  SET_PARENT(n, v, p);
+}
+
+// rbtree.c의 rbtree_delete_fixup과 같은 네 가지 경우
+static void delete_fixup(crbtree *t, uint32_t x) {
+  cnode_t *n = t->nodes;
+
+  while (x != t->root && COLOR(n, x) == RBTREE_BLACK) {
+    uint32_t p = PARENT(n, x);
+
+    if (x == n[p].left) {
+      uint32_t w = n[p].right;
+
+      if (COLOR(n, w) == RBTREE_RED) {
+        SET_COLOR(n, w, RBTREE_BLACK);
+        SET_COLOR(n, p, RBTREE_RED);
+        left_rotate(t, p);
+        w = n[p].right;
+      }
+      if (COLOR(n, n[w].left) == RBTREE_BLACK && COLOR(n, n[w].right) == RBTREE_BLACK) {
+        SET_COLOR(n, w, RBTREE_RED);
+        x = p;
+      } else {
+        if (COLOR(n, n[w].right) == RBTREE_BLACK) {
+          SET_COLOR(n, n[w].left, RBTREE_BLACK);
+          SET_COLOR(n, w, RBTREE_RED);
+          right_rotate(t, w);
+          w = n[p].right;
+        }
+        SET_COLOR(n, w, COLOR(n, p));
+        SET_COLOR(n, p, RBTREE_BLACK);
+        SET_COLOR(n, n[w].right, RBTREE_BLACK);
+        left_rotate(t, p);
+        x = t->root;
+      }
+    } else {
+      uint32_t w = n[p].left;
+
+      if (COLOR(n, w) == RBTREE_RED) {
+        SET_COLOR(n, w, RBTREE_BLACK);
+        SET_COLOR(n, p, RBTREE_RED);
+        right_rotate(t, p);
+        w = n[p].left;
+      }
+      if (COLOR(n, n[w].right) == RBTREE_BLACK && COLOR(n, n[w].left) == RBTREE_BLACK) {
+        SET_COLOR(n, w, RBTREE_RED);
+        x = p;
+      } else {
+        if (COLOR(n, n[w].left) == RBTREE_BLACK) {
+          SET_COLOR(n, n[w].right, RBTREE_BLACK);
+          SET_COLOR(n, w, RBTREE_RED);
+          left_rotate(t, w);
+          w = n[p].left;
+        }
+        SET_COLOR(n, w, COLOR(n, p));
+        SET_COLOR(n, p, RBTREE_BLACK);
+        SET_COLOR(n, n[w].left, RBTREE_BLACK);
+        right_rotate(t, p);
+        x = t->root;
+      }
+    }
+  }
+
+  SET_COLOR(n, x, RBTREE_BLACK);
+}
@@ -0,0 +1,44 @@
+#ifndef _CRBTREE_H_
+#define _CRBTREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"  // color_t, key_t
+
+// Compact RB tree: nodes live in one array and link to each other by
+// 32-bit index, with the color packed into the low bit of the parent link.
+// Index 0 is the sentinel, so a node is 16 bytes instead of 48.
+
+#define CRBTREE_NIL 0
+
+typedef struct {
+  key_t key;
+  uint32_t parent_color;  // parent index << 1 | color
+  uint32_t left, right;
+} cnode_t;
+
+typedef struct {
+  uint32_t root;
+  uint32_t free_nodes;  // erased slots, linked through left
+  uint32_t used, cap;   // slots handed out and allocated, including nodes[0]
+  cnode_t *nodes;
+} crbtree;
+
+crbtree *new_crbtree(void);
+void delete_crbtree(crbtree *);
+
+// Nodes are identified by index, CRBTREE_NIL meaning none. An index stays
+// valid until its node is erased, but nodes may move when the array grows,
+// so keep indexes rather than pointers across inserts.
+uint32_t crbtree_insert(crbtree *, const key_t);
+uint32_t crbtree_find(const crbtree *, const key_t);
+uint32_t crbtree_min(const crbtree *);
+uint32_t crbtree_max(const crbtree *);
+int crbtree_erase(crbtree *, uint32_t);
+
+int crbtree_to_array(const crbtree *, key_t *, const size_t);
+
+#define crbtree_key(t, i) ((t)->nodes[i].key)
+
+#endif  // _CRBTREE_H_
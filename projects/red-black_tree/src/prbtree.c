@@ -0,0 +1,414 @@
+#include "prbtree.h"
+
+#include <stdlib.h>
+
+// RB tree의 높이는 2 log2(n + 1)을 넘지 않으므로 size_t 개수의 tree는 이 안에 들어감
+#define PRB_MAX_DEPTH 128
+
+// 한 level에서 복사될 수 있는 노드 수의 상한
+// 경로 위 노드, 색을 바꾸는 두 자식, 회전으로 올라오는 손자까지
+#define PRB_COPIES_PER_LEVEL 8
+
+// 다른 thread가 snapshot을 지우면서 같은 노드의 refs를 바꿀 수 있으므로 atomic으로 다룸
+#define REFS(x) __atomic_load_n(&(x)->refs, __ATOMIC_ACQUIRE)
+
+// Jiwon Functions
+
+static int reserve(prbtree *t);
+static pnode_t *node_alloc(prbtree *t);
+static void share(pnode_t *x);
+static void release(pnode_t *x);
+static pnode_t *own(prbtree *t, pnode_t **link);
+static int is_red(const pnode_t *x);
+static void rotate_left(prbtree *t, pnode_t **link);
+static void rotate_right(prbtree *t, pnode_t **link);
+static void flip_colors(prbtree *t, pnode_t *h);
+static void move_red_left(prbtree *t, pnode_t **link);
+static void move_red_right(prbtree *t, pnode_t **link);
+static void fix_up(prbtree *t, pnode_t **link);
+static void insert_rec(prbtree *t, pnode_t **link, const key_t key);
+static void erase_min(prbtree *t, pnode_t **link);
+static void erase_rec(prbtree *t, pnode_t **link, const key_t key);
+
+// 빈 persistent RB tree 생성
+prbtree *new_prbtree(void) {
+  return (prbtree *)calloc(1, sizeof(prbtree));
+}
+
+// 이 tree가 가진 참조만 놓음, 다른 snapshot과 공유하던 노드는 남아 있음
+void delete_prbtree(prbtree *t) {
+  release(t->root);
+  while (t->spare != NULL) {
+    pnode_t *next = t->spare->right;
+    free(t->spare);
+    t->spare = next;
+  }
+  free(t);
+}
+
+// 지금 내용 그대로인 tree를 O(1)에 만듦, root만 공유하고 복사는 나중에 바꿀 때 일어남
+prbtree *prbtree_snapshot(const prbtree *t) {
+  prbtree *s = (prbtree *)calloc(1, sizeof(prbtree));
+  if (s == NULL) {
+    return NULL;
+  }
+
+  s->root = t->root;
+  share(s->root);
+  s->size = t->size;
+
+  return s;
+}
+
+// key 추가, 메모리가 부족하면 -1 반환하고 tree는 그대로
+int prbtree_insert(prbtree *t, const key_t key) {
+  if (reserve(t) < 0) {
+    return -1;
+  }
+
+  insert_rec(t, &t->root, key);
+  t->root->color = RBTREE_BLACK;
+  t->size++;
+
+  return 0;
+}
+
+// key 하나 삭제, 없거나 메모리가 부족하면 -1 반환
+int prbtree_erase(prbtree *t, const key_t key) {
+  if (!prbtree_find(t, key) || reserve(t) < 0) {
+    return -1;
+  }
+
+  // root가 2-node면 빨갛게 칠해 두어 내려가는 쪽에 빌려줄 red link를 만듦
+  pnode_t *r = own(t, &t->root);
+  if (!is_red(r->left) && !is_red(r->right)) {
+    r->color = RBTREE_RED;
+  }
+
+  erase_rec(t, &t->root, key);
+  if (t->root != NULL) {
+    t->root->color = RBTREE_BLACK;
+  }
+  t->size--;
+
+  return 0;
+}
+
+// key가 있으면 1, 없으면 0
+int prbtree_find(const prbtree *t, const key_t key) {
+  pnode_t *x = t->root;
+
+  while (x != NULL) {
+    if (key == x->key) {
+      return 1;
+    }
+    x = (key < x->key) ? x->left : x->right;
+  }
+
+  return 0;
+}
+
+// 가장 작은 key를 *out에 저장하고 1 반환, 빈 tree면 0
+int prbtree_min(const prbtree *t, key_t *out) {
+  pnode_t *x = t->root;
+
+  if (x == NULL) {
+    return 0;
+  }
+  while (x->left != NULL) {
+    x = x->left;
+  }
+
+  *out = x->key;
+  return 1;
+}
+
+// 가장 큰 key를 *out에 저장하고 1 반환, 빈 tree면 0
+int prbtree_max(const prbtree *t, key_t *out) {
+  pnode_t *x = t->root;
+
+  if (x == NULL) {
+    return 0;
+  }
+  while (x->right != NULL) {
+    x = x->right;
+  }
+
+  *out = x->key;
+  return 1;
+}
+
+// key 순서대로 최대 n개를 arr에 복사
+int prbtree_to_array(const prbtree *t, key_t *arr, const size_t n) {
+  pnode_t *stack[PRB_MAX_DEPTH];
+  int top = 0;
+  size_t i = 0;
+
+  for (pnode_t *x = t->root; x != NULL; x = x->left) {
+    stack[top++] = x;
+  }
+
+  while (top > 0 && i < n) {
+    pnode_t *x = stack[--top];
+    arr[i++] = x->key;
+    for (x = x->right; x != NULL; x = x->left) {
+      stack[top++] = x;
+    }
+  }
+
+  return 0;
+}
+
+// lo 이상 hi 이하인 key를 순서대로 visit에 넘김, visit이 0이 아닌 값을 반환하면 멈춤
+// 넘긴 key의 개수 반환
+size_t prbtree_range(const prbtree *t, const key_t lo, const key_t hi,
+                     int (*visit)(key_t, void *), void *arg) {
+  pnode_t *stack[PRB_MAX_DEPTH];
+  int top = 0;
+  size_t count = 0;
+
+  // lo 이상인 첫 노드까지 내려가면서, 왼쪽으로 꺾은 노드만 나중에 방문할 차례가 옴
+  for (pnode_t *x = t->root; x != NULL;) {
+    if (x->key >= lo) {
+      stack[top++] = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+
+  while (top > 0) {
+    pnode_t *x = stack[--top];
+    if (x->key > hi) {
+      break;
+    }
+    count++;
+    if (visit(x->key, arg)) {
+      break;
+    }
+    for (x = x->right; x != NULL; x = x->left) {
+      stack[top++] = x;
+    }
+  }
+
+  return count;
+}
+
+// Jiwon Functions
+
+// 이번 변경에서 복사하거나 새로 만들 노드를 미리 확보
+// 한 번 확보한 노드는 다음 변경에서 다시 쓰므로 보통은 malloc을 부르지 않음
+static int reserve(prbtree *t) {
+  int height = 1;
+  for (size_t n = t->size + 1; n > 1; n >>= 1) {
+    height++;
+  }
+  size_t need = PRB_COPIES_PER_LEVEL * (2 * (size_t)height + 1);
+
+  while (t->spare_count < need) {
+    pnode_t *x = (pnode_t *)malloc(sizeof(pnode_t));
+    if (x == NULL) {
+      return -1;
+    }
+    x->right = t->spare;
+    t->spare = x;
+    t->spare_count++;
+  }
+
+  return 0;
+}
+
+static pnode_t *node_alloc(prbtree *t) {
+  pnode_t *x = t->spare;
+  t->spare = x->right;
+  t->spare_count--;
+  x->refs = 1;
+  return x;
+}
+
+static void share(pnode_t *x) {
+  if (x != NULL) {
+    __atomic_add_fetch(&x->refs, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// 참조 하나를 놓고, 마지막 참조였으면 노드를 반환하고 자식의 참조도 놓음
+static void release(pnode_t *x) {
+  while (x != NULL && __atomic_sub_fetch(&x->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    release(x->left);
+    pnode_t *next = x->right;
+    free(x);
+    x = next;
+  }
+}
+
+// *link가 가리키는 노드를 이 tree만 쓰도록 만들어 반환
+// 다른 version과 공유 중이면 복사본으로 바꾸고, 원래 노드의 자식은 양쪽에서 공유됨
+// 내려오는 경로 위 노드를 모두 own 해 두었으므로 refs가 1이면 다른 누구도 볼 수 없음
+static pnode_t *own(prbtree *t, pnode_t **link) {
+  pnode_t *x = *link;
+
+  if (x == NULL || REFS(x) == 1) {
+    return x;
+  }
+
+  pnode_t *y = node_alloc(t);
+  y->key = x->key;
+  y->color = x->color;
+  y->left = x->left;
+  y->right = x->right;
+  share(y->left);
+  share(y->right);
+
+  *link = y;
+  release(x);
+
+  return y;
+}
+
+static int is_red(const pnode_t *x) {
+  return x != NULL && x->color == RBTREE_RED;
+}
+
+// *link는 이미 own 된 노드여야 함
+static void rotate_left(prbtree *t, pnode_t **link) {
+  pnode_t *h = *link;
+  pnode_t *x = own(t, &h->right);
+
+  h->right = x->left;
+  x->left = h;
+  x->color = h->color;
+  h->color = RBTREE_RED;
+  *link = x;
+}
+
+static void rotate_right(prbtree *t, pnode_t **link) {
+  pnode_t *h = *link;
+  pnode_t *x = own(t, &h->left);
+
+  h->left = x->right;
+  x->right = h;
+  x->color = h->color;
+  h->color = RBTREE_RED;
+  *link = x;
+}
+
+// h와 두 자식의 색을 뒤집음, 2-3-4 tree로 보면 노드를 나누거나 합치는 것
+static void flip_colors(prbtree *t, pnode_t *h) {
+  pnode_t *l = own(t, &h->left);
+  pnode_t *r = own(t, &h->right);
+
+  h->color = !h->color;
+  l->color = !l->color;
+  r->color = !r->color;
+}
+
+// 왼쪽 자식이 2-node일 때 형제에게서 빌리거나 합쳐서 왼쪽으로 내려갈 red link를 만듦
+static void move_red_left(prbtree *t, pnode_t **link) {
+  flip_colors(t, *link);
+  if (is_red((*link)->right->left)) {
+    rotate_right(t, &(*link)->right);
+    rotate_left(t, link);
+    flip_colors(t, *link);
+  }
+}
+
+static void move_red_right(prbtree *t, pnode_t **link) {
+  flip_colors(t, *link);
+  if (is_red((*link)->left->left)) {
+    rotate_right(t, link);
+    flip_colors(t, *link);
+  }
+}
+
+// 올라오면서 오른쪽으로 기운 red link와 연달아 나온 red link, 4-node를 정리
+static void fix_up(prbtree *t, pnode_t **link) {
+  if (is_red((*link)->right) && !is_red((*link)->left)) {
+    rotate_left(t, link);
+  }
+  if (is_red((*link)->left) && is_red((*link)->left->left)) {
+    rotate_right(t, link);
+  }
+  if (is_red((*link)->left) && is_red((*link)->right)) {
+    flip_colors(t, *link);
+  }
+}
+
+static void insert_rec(prbtree *t, pnode_t **link, const key_t key) {
+  if (*link == NULL) {
+    pnode_t *x = node_alloc(t);
+    x->key = key;
+    x->color = RBTREE_RED;
+    x->left = x->right = NULL;
+    *link = x;
+    return;
+  }
+
+  // 같은 key는 오른쪽으로 보내서 먼저 들어온 key가 앞에 오도록
+  pnode_t *h = own(t, link);
+  if (key < h->key) {
+    insert_rec(t, &h->left, key);
+  } else {
+    insert_rec(t, &h->right, key);
+  }
+
+  fix_up(t, link);
+}
+
+// *link subtree에서 가장 작은 노드 삭제
+// 왼쪽이 비어 있으면 left-leaning이라 오른쪽도 비어 있음
+static void erase_min(prbtree *t, pnode_t **link) {
+  pnode_t *h = own(t, link);
+
+  if (h->left == NULL) {
+    *link = NULL;
+    free(h);
+    return;
+  }
+
+  if (!is_red(h->left) && !is_red(h->left->left)) {
+    move_red_left(t, link);
+  }
+  erase_min(t, &(*link)->left);
+  fix_up(t, link);
+}
+
+// key가 subtree 안에 있을 때만 불러야 함
+static void erase_rec(prbtree *t, pnode_t **link, const key_t key) {
+  pnode_t *h = own(t, link);
+
+  if (key < h->key) {
+    if (!is_red(h->left) && !is_red(h->left->left)) {
+      move_red_left(t, link);
+    }
+    erase_rec(t, &(*link)->left, key);
+  } else {
+    if (is_red(h->left)) {
+      rotate_right(t, link);
+    }
+    h = *link;
+    if (key == h->key && h->right == NULL) {
+      *link = NULL;
+      free(h);
+      return;
+    }
+    if (!is_red(h->right) && !is_red(h->right->left)) {
+      move_red_right(t, link);
+    }
+    // move_red_right가 회전했으면 h는 오른쪽 자식으로 내려갔으므로,
+    // 새로 올라온 노드가 같은 key (중복)여도 h를 따라 오른쪽으로 내려감
+    if (*link == h && key == h->key) {
+      // 오른쪽 subtree의 최솟값을 이 자리로 올리고 그 노드를 지움
+      pnode_t *m = h->right;
+      while (m->left != NULL) {
+        m = m->left;
+      }
+      h->key = m->key;
+      erase_min(t, &h->right);
+    } else {
+      erase_rec(t, &(*link)->right, key);
+    }
+  }
+
+  fix_up(t, link);
+}
@@ -0,0 +1,48 @@
+#ifndef _PRBTREE_H_
+#define _PRBTREE_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"  // color_t, key_t
+
+// Persistent RB tree multiset with O(1) snapshots. Nodes have no parent
+// links and are shared between versions with a reference count; an
+// insert or erase copies only the shared nodes on the path it changes
+// (path copying), so a snapshot keeps seeing the tree as it was when it
+// was taken. The tree is left-leaning (every red link leans left), which
+// lets both insert and erase fix colors on the way back up the path.
+//
+// A snapshot is an ordinary prbtree: it can be read, changed or deleted
+// independently of the tree it came from. Take a snapshot from the thread
+// that changes the tree (or under its lock); after that the snapshot may
+// be scanned and deleted by another thread while the tree keeps changing.
+
+typedef struct pnode_t {
+  key_t key;
+  color_t color;
+  unsigned refs;  // links from parents and trees pointing at this node
+  struct pnode_t *left, *right;
+} pnode_t;
+
+typedef struct {
+  pnode_t *root;
+  size_t size;
+  // nodes reserved before each change so path copying never fails midway
+  pnode_t *spare;
+  size_t spare_count;
+} prbtree;
+
+prbtree *new_prbtree(void);
+void delete_prbtree(prbtree *);
+prbtree *prbtree_snapshot(const prbtree *);
+
+int prbtree_insert(prbtree *, const key_t);
+int prbtree_erase(prbtree *, const key_t);
+int prbtree_find(const prbtree *, const key_t);
+int prbtree_min(const prbtree *, key_t *);
+int prbtree_max(const prbtree *, key_t *);
+
+int prbtree_to_array(const prbtree *, key_t *, const size_t);
+size_t prbtree_range(const prbtree *, const key_t, const key_t, int (*)(key_t, void *), void *);
+
+#endif  // _PRBTREE_H_
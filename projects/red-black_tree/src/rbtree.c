@@ -1,16 +1,43 @@
 #include "rbtree.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+// 노드 풀의 chunk 크기: 처음엔 작게 시작해서 두 배씩 키움
+#define NODE_CHUNK_MIN 32
+#define NODE_CHUNK_MAX 4096
+
+// insert_many에서 추가할 key가 tree 크기의 1/8보다 적으면 하나씩 삽입하고,
+// 그보다 많으면 기존 key와 병합해서 tree를 새로 만듦
+#define BULK_REBUILD_RATIO 8
+
+// rbtree_seq.c의 reader가 lock 없이 relaxed atomic으로 읽는 필드 (root, left, right, parent, key)는
+// 바꾸는 쪽도 atomic store로 써야 data race가 아님, relaxed store는 보통의 mov로 컴파일됨
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+// 노드들을 한꺼번에 할당하는 단위, tree마다 chunks로 연결
+typedef struct node_chunk {
+  struct node_chunk *next;
+  size_t cap;
+  node_t nodes[];
+} node_chunk;
 
 // Jiwon Functions
 
-void delete_node(node_t *p, rbtree *t);
+node_t *node_alloc(rbtree *t);
+void node_free(rbtree *t, node_t *p);
+int node_reserve(rbtree *t, const size_t n);
 void left_rotate(rbtree *t, node_t *x);
 void right_rotate(rbtree *t, node_t *x);
 void rbtree_insert_fixup(rbtree *t, node_t *z);
 void rbtree_transplant(rbtree *t, node_t *u, node_t *v);
 void rbtree_delete_fixup(rbtree *t, node_t *x);
-int inorder_array(node_t *p, const rbtree *t, key_t *arr, const size_t n, int index);
+size_t count_less(const rbtree *t, const key_t key, int inclusive);
+int build_tree(rbtree *t, const key_t *arr, const size_t n);
+int red_depth_of(const size_t n);
+node_t *build_sorted(rbtree *t, const key_t *arr, const size_t n, int depth, int red_depth);
+node_t *link_sorted(rbtree *t, node_t **nodes, const size_t n, int depth, int red_depth);
+int key_compare(const void *a, const void *b);
 
 // RB tree 구조체 생성
 // 여러 개의 tree를 생성할 수 있어야 하며 각각 다른 내용들을 저장할 수 있어야 합니다.
@@ -34,7 +61,13 @@ rbtree *new_rbtree(void) {
 void delete_rbtree(rbtree *t) {
   // TODO: reclaim the tree nodes's memory
 
-  delete_node(t->root, t);
+  // 노드는 모두 chunk 안에 있으므로 tree를 순회할 필요 없이 chunk만 반환
+  node_chunk *c = t->chunks;
+  while (c != NULL) {
+    node_chunk *next = c->next;
+    free(c);
+    c = next;
+  }
 
   free(t->nil);
   t->nil = NULL;
@@ -49,8 +82,11 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
   // TODO: implement insert
 
   // Insert할 새 노드 생성
-  node_t *z = (node_t *)calloc(1, sizeof(node_t));
-  z->key = key;
+  node_t *z = node_alloc(t);
+  if (z == NULL) {
+    return NULL;
+  }
+  STORE(z->key, key);
 
   // Root, Nil 노드를 가리키는 임시 포인터
   node_t *x = t->root;
@@ -58,6 +94,8 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
 
   while (x != t->nil) {
     y = x;
+    // 내려가는 경로의 모든 노드는 subtree에 Z가 하나 더 생김
+    x->size++;
 
     if (key < x->key) {
       x = x->left;
@@ -67,23 +105,25 @@ node_t *rbtree_insert(rbtree *t, const key_t key) {
   }
 
   // 새 노드의 부모를 Y로 지정
-  z->parent = y;
+  STORE(z->parent, y);
+
+  // 새 노드의 자식들 설정
+  // tree에 연결하기 전에 채워 두어야 lock 없이 읽는 쪽 (rbtree_seq.c)이 쓰레기 값을 따라가지 않음
+  STORE(z->left, t->nil);         
+  STORE(z->right, t->nil);
+  z->size = 1;
+  // 삽입하는 노드는 항상 RED
+  z->color = RBTREE_RED;
 
   // 값을 비교하며 왼쪽 또는 오른쪽 자식으로 내려감
   if (y == t->nil) {
-    t->root = z;
+    STORE(t->root, z);
   } else if (key < y->key) {
-    y->left = z;
+    STORE(y->left, z);
   } else {
-    y->right = z;
+    STORE(y->right, z);
   }
 
-  // 새 노드의 자식들 설정
-  z->left = t->nil;         
-  z->right = t->nil;
-  // 삽입하는 노드는 항상 RED
-  z->color = RBTREE_RED;
-
   rbtree_insert_fixup(t, z);
 
   return t->root;
@@ -179,21 +219,27 @@ int rbtree_erase(rbtree *t, node_t *z) {
     if (y->parent == z) {
       // 삭제할 노드와 해당 노드의 자식 노드 사이에 어떠한 노드도 없을 경우,
       // 자식 노드를 부모 노드 자리로 이동시켜주기만 하면 됨
-      x->parent = y;
+      STORE(x->parent, y);
 
     } else {
       // 삭제할 노드와 해당 노드의 자식 노드 사이에 다른 노드들이 있을 경우,
       rbtree_transplant(t, y, y->right);
-      y->right = z->right;
-      y->right->parent = y;
+      STORE(y->right, z->right);
+      STORE(y->right->parent, y);
     }
 
     rbtree_transplant(t, z, y);
-    y->left = z->left;
-    y->left->parent = y;
+    STORE(y->left, z->left);
+    STORE(y->left->parent, y);
     y->color = z->color;
   }
 
+  // X의 부모부터 root까지 subtree 크기 다시 계산
+  // X가 nil이어도 transplant가 nil->parent를 설정해 두었음
+  for (node_t *p = x->parent; p != t->nil; p = p->parent) {
+    p->size = p->left->size + p->right->size + 1;
+  }
+
   // 삭제하려는 색이 RED라면, 어떠한 속성도 위반하지 않음
   // 하지만 삭제하려는 색이 BLACK이라면, 속성 위반 가능
   if (y_original_color == RBTREE_BLACK) {
@@ -201,8 +247,7 @@ int rbtree_erase(rbtree *t, node_t *z) {
   }
   
   // 트리와 떨어진 노드 반환: delete는 트리와 이어진 노드만 반환하기 때문
-  free(z);
-  z = NULL;
+  node_free(t, z);
 
   return 0;
 }
@@ -213,75 +258,350 @@ int rbtree_erase(rbtree *t, node_t *z) {
 int rbtree_to_array(const rbtree *t, key_t *arr, const size_t n) {
   // TODO: implement to_array
 
-  inorder_array(t->root, t, arr, n, 0);
+  // 재귀 대신 successor를 따라가며 n개까지만 채움
+  node_t *p = (t->root == t->nil) ? NULL : rbtree_min(t);
+
+  for (size_t i = 0; p != NULL && i < n; i++) {
+    arr[i] = p->key;
+    p = rbtree_next(t, p);
+  }
 
   return 0;
 }
 
+// key 순서로 P 다음 노드 반환, P가 마지막이면 NULL
+node_t *rbtree_next(const rbtree *t, node_t *p) {
+  // 오른쪽 subtree가 있으면 그 중 가장 작은 노드
+  if (p->right != t->nil) {
+    p = p->right;
+    while (p->left != t->nil) {
+      p = p->left;
+    }
+    return p;
+  }
+
+  // 없으면 왼쪽 자식 쪽에서 올라오게 되는 첫 조상
+  node_t *y = p->parent;
+  while (y != t->nil && p == y->right) {
+    p = y;
+    y = y->parent;
+  }
+
+  return (y == t->nil) ? NULL : y;
+}
+
+// key 순서로 P 이전 노드 반환, P가 처음이면 NULL
+node_t *rbtree_prev(const rbtree *t, node_t *p) {
+  if (p->left != t->nil) {
+    p = p->left;
+    while (p->right != t->nil) {
+      p = p->right;
+    }
+    return p;
+  }
+
+  node_t *y = p->parent;
+  while (y != t->nil && p == y->left) {
+    p = y;
+    y = y->parent;
+  }
+
+  return (y == t->nil) ? NULL : y;
+}
+
+// lo 이상 hi 이하인 노드를 key 순서대로 visit에 넘김, 방문한 노드 수 반환
+// visit이 0이 아닌 값을 반환하면 그 노드까지 세고 멈춤
+// lower bound를 찾는 데 O(log n), 이후 노드마다 평균 O(1)
+size_t rbtree_range(const rbtree *t, const key_t lo, const key_t hi,
+                    int (*visit)(node_t *, void *), void *arg) {
+  size_t count = 0;
+
+  for (node_t *p = rbtree_lower_bound(t, lo); p != NULL && p->key <= hi; p = rbtree_next(t, p)) {
+    count++;
+    if (visit(p, arg) != 0) {
+      break;
+    }
+  }
+
+  return count;
+}
+
+// 정렬된 (non-decreasing) array로 RB tree를 O(n)에 생성, 메모리가 부족하면 NULL 반환
+rbtree *rbtree_from_sorted_array(const key_t *arr, const size_t n) {
+  rbtree *t = new_rbtree();
+
+  if (build_tree(t, arr, n) < 0) {
+    delete_rbtree(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+// 정렬되지 않은 key n개를 한꺼번에 추가, 메모리가 부족하면 tree를 그대로 두고 -1 반환
+// 적은 수는 정렬한 순서대로 하나씩 삽입하고, 많으면 기존 노드와 병합해 O(size + n)에 다시 연결함
+// 어느 쪽이든 기존 노드는 그대로 쓰므로 이전에 받은 node pointer는 계속 유효함
+int rbtree_insert_many(rbtree *t, const key_t *arr, const size_t n) {
+  size_t size = t->root->size;
+
+  if (n == 0) {
+    return 0;
+  }
+
+  key_t *keys = (key_t *)malloc(n * sizeof(key_t));
+  if (keys == NULL) {
+    return -1;
+  }
+  memcpy(keys, arr, n * sizeof(key_t));
+  qsort(keys, n, sizeof(key_t), key_compare);
+
+  if (n < size / BULK_REBUILD_RATIO) {
+    // 노드를 먼저 확보해 두어 중간에 삽입이 실패해서 일부만 들어가는 일이 없도록
+    if (node_reserve(t, n) < 0) {
+      free(keys);
+      return -1;
+    }
+    // 정렬된 순서로 넣으면 이웃한 key들의 경로가 캐시에 남아 있음
+    for (size_t i = 0; i < n; i++) {
+      rbtree_insert(t, keys[i]);
+    }
+    free(keys);
+    return 0;
+  }
+
+  // 새 key의 노드를 먼저 확보해 두어 실패하면 tree는 그대로 남음
+  node_t **nodes = (node_t **)malloc((size + n) * sizeof(node_t *));
+  if (nodes == NULL || node_reserve(t, n) < 0) {
+    free(nodes);
+    free(keys);
+    return -1;
+  }
+
+  // 기존 노드를 key 순서대로 nodes 뒤쪽에 두고 앞에서부터 새 노드와 병합
+  // 쓰는 위치가 기존 노드를 읽는 위치를 앞지르지 않으므로 같은 배열에서 병합 가능
+  size_t i = n, j = 0, k = 0;
+  if (size > 0) {
+    for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)) {
+      nodes[i++] = p;
+    }
+  }
+
+  i = n;
+  while (j < n) {
+    if (i < size + n && nodes[i]->key <= keys[j]) {
+      nodes[k++] = nodes[i++];
+    } else {
+      node_t *p = node_alloc(t);
+      STORE(p->key, keys[j++]);
+      nodes[k++] = p;
+    }
+  }
+
+  STORE(t->root, link_sorted(t, nodes, size + n, 0, red_depth_of(size + n)));
+  STORE(t->root->parent, t->nil);
+
+  free(nodes);
+  free(keys);
+  return 0;
+}
+
+// RB tree의 노드 수
+size_t rbtree_size(const rbtree *t) {
+  return t->root->size;
+}
+
+// key 순서로 k번째 (0부터 시작) node pointer 반환
+// k가 노드 수 이상이면 NULL 반환
+node_t *rbtree_select(const rbtree *t, const size_t k) {
+  node_t *x = t->root;
+  size_t i = k;
+
+  while (x != t->nil) {
+    // 왼쪽 subtree 크기가 곧 X의 순위
+    if (i < x->left->size) {
+      x = x->left;
+    } else if (i > x->left->size) {
+      i -= x->left->size + 1;
+      x = x->right;
+    } else {
+      return x;
+    }
+  }
+
+  return NULL;
+}
+
+// key보다 작은 key의 개수, 즉 key가 들어갈 자리의 순위 반환
+size_t rbtree_rank(const rbtree *t, const key_t key) {
+  return count_less(t, key, 0);
+}
+
+// lo 이상 hi 이하인 key의 개수 반환
+size_t rbtree_count_range(const rbtree *t, const key_t lo, const key_t hi) {
+  if (lo > hi) {
+    return 0;
+  }
+
+  return count_less(t, hi, 1) - count_less(t, lo, 0);
+}
+
+// key 이상인 첫 번째 node pointer 반환, 없으면 NULL
+node_t *rbtree_lower_bound(const rbtree *t, const key_t key) {
+  node_t *x = t->root;
+  node_t *found = NULL;
+
+  while (x != t->nil) {
+    if (x->key >= key) {
+      // 후보로 기억해 두고 더 작은 쪽에서 계속 찾음
+      found = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+
+  return found;
+}
+
+// key보다 큰 첫 번째 node pointer 반환, 없으면 NULL
+node_t *rbtree_upper_bound(const rbtree *t, const key_t key) {
+  node_t *x = t->root;
+  node_t *found = NULL;
+
+  while (x != t->nil) {
+    if (x->key > key) {
+      found = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+
+  return found;
+}
+
 // Jiwon Functions
 
-void delete_node(node_t *p, rbtree *t) {
-  if (p == t->nil) {
-    return;
+// 노드 하나 할당: 반환된 노드가 있으면 재사용하고, 없으면 현재 chunk에서 잘라냄
+// chunk가 다 차면 두 배 크기의 chunk를 새로 할당, 메모리가 부족하면 NULL 반환
+node_t *node_alloc(rbtree *t) {
+  node_t *p = t->free_nodes;
+
+  if (p != NULL) {
+    t->free_nodes = p->right;
+    return p;
+  }
+
+  node_chunk *c = t->chunks;
+  if (c == NULL || t->chunk_used == c->cap) {
+    size_t cap = (c == NULL) ? NODE_CHUNK_MIN : c->cap * 2;
+    if (cap > NODE_CHUNK_MAX) {
+      cap = NODE_CHUNK_MAX;
+    }
+
+    // 0으로 채워 두면 아직 쓰지 않은 노드의 포인터는 NULL
+    c = (node_chunk *)calloc(1, sizeof(node_chunk) + cap * sizeof(node_t));
+    if (c == NULL) {
+      return NULL;
+    }
+    c->next = t->chunks;
+    c->cap = cap;
+    t->chunks = c;
+    t->chunk_used = 0;
+  }
+
+  return &c->nodes[t->chunk_used++];
+}
+
+// 노드를 free list에 반환, right 포인터를 다음 노드 연결에 사용
+void node_free(rbtree *t, node_t *p) {
+  STORE(p->right, t->free_nodes);
+  t->free_nodes = p;
+}
+
+// 노드 n개가 free list에 있도록 미리 할당, 메모리가 부족하면 -1 반환
+// 실패해도 이미 할당한 노드는 free list에 남아 다음 할당에 쓰임
+int node_reserve(rbtree *t, const size_t n) {
+  node_t *got = NULL;
+  int ret = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = node_alloc(t);
+    if (p == NULL) {
+      ret = -1;
+      break;
+    }
+    p->right = got;
+    got = p;
   }
 
-  delete_node(p->left, t);
-  delete_node(p->right, t);
+  while (got != NULL) {
+    node_t *next = got->right;
+    node_free(t, got);
+    got = next;
+  }
 
-  free(p);
-  p = NULL;
+  return ret;
 }
 
 void left_rotate(rbtree *t, node_t *x) {
   // X와 Y의 상관관계 저장
   node_t *y = x->right;
-  x->right = y->left;
+  STORE(x->right, y->left);
 
   // Y의 왼쪽 자식이 유효한 값이면,
   if (y->left != t->nil) {
-    y->left->parent = x;
+    STORE(y->left->parent, x);
   }
   // X의 부모를 Y로 연결
-  y->parent = x->parent;
+  STORE(y->parent, x->parent);
 
   // X의 부모가 nil이라는 것은, X가 root라는 뜻
   if (x->parent == t->nil) {
-    t->root = y;
+    STORE(t->root, y);
   } else if (x == x->parent->left) {
-    x->parent->left = y;
+    STORE(x->parent->left, y);
   } else {
-    x->parent->right = y;
+    STORE(x->parent->right, y);
   }
 
   // X와 Y의 상관관계 저장
-  y->left = x;
-  x->parent = y;
+  STORE(y->left, x);
+  STORE(x->parent, y);
+
+  // Y가 X의 subtree를 그대로 물려받고, X는 자식들로 다시 계산
+  y->size = x->size;
+  x->size = x->left->size + x->right->size + 1;
 }
 
 void right_rotate(rbtree *t, node_t *x) {
   // X와 Y의 상관관계 저장
   node_t *y = x->left; 
-  x->left = y->right;
+  STORE(x->left, y->right);
 
   // X의 오른쪽 자식이 유효한 값이면, 즉 nil이 아니라면,
   if (y->right != t->nil) {
-    y->right->parent = x;
+    STORE(y->right->parent, x);
   }
   // Y의 부모를 X로 연결
-  y->parent = x->parent; 
+  STORE(y->parent, x->parent); 
 
   // Y의 부모가 nil이라는 것은, Y가 root라는 뜻
   if (x->parent == t->nil) {
-    t->root = y;
+    STORE(t->root, y);
   } else if (x == x->parent->right) {
-    x->parent->right = y;
+    STORE(x->parent->right, y);
   } else {
-    x->parent->left = y;
+    STORE(x->parent->left, y);
   }
 
   // X와 Y의 상관관계 저장
-  y->right = x;
-  x->parent = y;
+  STORE(y->right, x);
+  STORE(x->parent, y);
+
+  // Y가 X의 subtree를 그대로 물려받고, X는 자식들로 다시 계산
+  y->size = x->size;
+  x->size = x->left->size + x->right->size + 1;
 }
 
 // Case 1: Z의 삼촌 Y가 RED인 경우
@@ -357,14 +677,14 @@ void rbtree_insert_fixup(rbtree *t, node_t *z) {
 
 void rbtree_transplant(rbtree *t, node_t *u, node_t *v) {
   if (u->parent == t->nil) {
-    t->root = v;
+    STORE(t->root, v);
   } else if (u == u->parent->left) {
-    u->parent->left = v;
+    STORE(u->parent->left, v);
   } else {
-    u->parent->right = v;
+    STORE(u->parent->right, v);
   }
 
-  v->parent = u->parent;
+  STORE(v->parent, u->parent);
 }
 
 // Case 1: X의 형제 W가 RED인 경우
@@ -454,17 +774,124 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
   x->color = RBTREE_BLACK;
 }
 
-int inorder_array(node_t *p, const rbtree *t, key_t *arr, const size_t n, int index) {
-  if (p == t->nil) {
-    return index;
+// key보다 작은 (inclusive면 key 이하인) key의 개수
+// 오른쪽으로 내려갈 때마다 왼쪽 subtree와 현재 노드를 더함
+size_t count_less(const rbtree *t, const key_t key, int inclusive) {
+  node_t *x = t->root;
+  size_t count = 0;
+
+  while (x != t->nil) {
+    if (x->key < key || (inclusive && x->key == key)) {
+      count += x->left->size + 1;
+      x = x->right;
+    } else {
+      x = x->left;
+    }
+  }
+
+  return count;
+}
+
+// 정렬된 array로 tree 전체를 다시 만듦
+// 노드 n개짜리 chunk를 먼저 할당해 두므로 실패하면 기존 tree는 그대로 남음
+int build_tree(rbtree *t, const key_t *arr, const size_t n) {
+  node_chunk *c = NULL;
+
+  if (n > 0) {
+    c = (node_chunk *)malloc(sizeof(node_chunk) + n * sizeof(node_t));
+    if (c == NULL) {
+      return -1;
+    }
+    c->next = NULL;
+    c->cap = n;
+  }
+
+  // 기존 노드는 모두 버림
+  node_chunk *old = t->chunks;
+  while (old != NULL) {
+    node_chunk *next = old->next;
+    free(old);
+    old = next;
+  }
+  t->chunks = c;
+  t->chunk_used = 0;
+  t->free_nodes = NULL;
+
+  t->root = build_sorted(t, arr, n, 0, red_depth_of(n));
+  t->root->parent = t->nil;
+
+  return 0;
+}
+
+// 노드 n개로 균형 잡힌 tree를 만들 때 RED로 칠할 depth
+// 가득 찬 level 아래 level의 노드만 RED로 칠하면
+// 모든 경로의 BLACK 노드 수가 같고 RED 노드의 자식은 모두 nil
+int red_depth_of(const size_t n) {
+  int red_depth = 0;
+
+  while (((n + 1) >> (red_depth + 1)) != 0) {
+    red_depth++;
+  }
+
+  return red_depth;
+}
+
+// arr의 가운데 key를 root로 하는 subtree를 만들어 반환
+// 왼쪽 subtree부터 만들어서 노드가 key 순서대로 chunk에 놓임
+node_t *build_sorted(rbtree *t, const key_t *arr, const size_t n, int depth, int red_depth) {
+  if (n == 0) {
+    return t->nil;
+  }
+
+  size_t mid = n / 2;
+  node_t *left = build_sorted(t, arr, mid, depth + 1, red_depth);
+  node_t *x = node_alloc(t);
+
+  x->key = arr[mid];
+  x->color = (depth == red_depth) ? RBTREE_RED : RBTREE_BLACK;
+  x->size = n;
+  x->left = left;
+  if (left != t->nil) {
+    left->parent = x;
+  }
+
+  x->right = build_sorted(t, arr + mid + 1, n - mid - 1, depth + 1, red_depth);
+  if (x->right != t->nil) {
+    x->right->parent = x;
+  }
+
+  return x;
+}
+
+// 정렬된 노드 array의 가운데 노드를 root로 하는 subtree로 다시 연결해 반환
+// build_sorted와 같은 모양과 색을 만들지만 노드를 새로 할당하지 않음
+node_t *link_sorted(rbtree *t, node_t **nodes, const size_t n, int depth, int red_depth) {
+  if (n == 0) {
+    return t->nil;
   }
 
-  index = inorder_array(p->left, t, arr, n, index);
+  size_t mid = n / 2;
+  node_t *x = nodes[mid];
+  node_t *left = link_sorted(t, nodes, mid, depth + 1, red_depth);
+  node_t *right = link_sorted(t, nodes + mid + 1, n - mid - 1, depth + 1, red_depth);
 
-  arr[index] = p->key;
-  index++;
+  x->color = (depth == red_depth) ? RBTREE_RED : RBTREE_BLACK;
+  x->size = n;
+  STORE(x->left, left);
+  if (left != t->nil) {
+    STORE(left->parent, x);
+  }
+  STORE(x->right, right);
+  if (right != t->nil) {
+    STORE(right->parent, x);
+  }
+
+  return x;
+}
 
-  index = inorder_array(p->right, t, arr, n, index);
+int key_compare(const void *a, const void *b) {
+  key_t x = *(const key_t *)a;
+  key_t y = *(const key_t *)b;
 
-  return index;
+  return (x > y) - (x < y);
 }
\ No newline at end of file
@@ -11,11 +11,16 @@ typedef struct node_t {
   color_t color;
   key_t key;
   struct node_t *parent, *left, *right;
+  size_t size;  // number of nodes in this subtree, 0 for nil
 } node_t;
 
 typedef struct {
   node_t *root;
   node_t *nil;  // for sentinel
+  // node pool: nodes are carved out of chunks and recycled through free_nodes
+  struct node_chunk *chunks;
+  node_t *free_nodes;
+  size_t chunk_used;
 } rbtree;
 
 rbtree *new_rbtree(void);
@@ -29,4 +34,21 @@ int rbtree_erase(rbtree *, node_t *);
 
 int rbtree_to_array(const rbtree *, key_t *, const size_t);
 
+// In-order iteration: start from rbtree_min/rbtree_max or a bound and
+// step with rbtree_next/rbtree_prev, which return NULL past either end.
+node_t *rbtree_next(const rbtree *, node_t *);
+node_t *rbtree_prev(const rbtree *, node_t *);
+size_t rbtree_range(const rbtree *, const key_t, const key_t,
+                    int (*)(node_t *, void *), void *);
+
+rbtree *rbtree_from_sorted_array(const key_t *, const size_t);
+int rbtree_insert_many(rbtree *, const key_t *, const size_t);
+
+size_t rbtree_size(const rbtree *);
+node_t *rbtree_select(const rbtree *, const size_t);
+size_t rbtree_rank(const rbtree *, const key_t);
+size_t rbtree_count_range(const rbtree *, const key_t, const key_t);
+node_t *rbtree_lower_bound(const rbtree *, const key_t);
+node_t *rbtree_upper_bound(const rbtree *, const key_t);
+
 #endif  // _RBTREE_H_
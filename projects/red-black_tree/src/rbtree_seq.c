@@ -0,0 +1,241 @@
+#include "rbtree_seq.h"
+
+#include <stdlib.h>
+
+// 읽는 쪽이 포기하고 lock을 잡기 전까지 다시 시도하는 횟수
+#define SEQ_RETRIES 8
+
+// RB tree의 높이는 2 log2(n + 1)을 넘지 않으므로, 한 번 내려가거나 올라가는 데
+// 이보다 많이 걸리면 writer가 바꾸는 중인 tree를 본 것
+#define SEQ_MAX_DEPTH 128
+
+// 읽는 쪽은 writer와 경쟁하므로 노드 필드를 한 번에 읽어야 함
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+
+// Jiwon Functions
+
+static void write_begin(seq_rbtree *t);
+static void write_end(seq_rbtree *t);
+static unsigned read_begin(const seq_rbtree *t);
+static int read_retry(const seq_rbtree *t, unsigned seq);
+static int walk_lower_bound(const rbtree *t, const key_t key, node_t **found);
+static int walk_next(const rbtree *t, node_t **p);
+static int walk_range(const rbtree *t, const key_t lo, const key_t hi, key_t *out,
+                      const size_t max, size_t *count);
+
+// 공유 RB tree 생성
+seq_rbtree *new_seq_rbtree(void) {
+  seq_rbtree *t = (seq_rbtree *)calloc(1, sizeof(seq_rbtree));
+  if (t == NULL) {
+    return NULL;
+  }
+
+  t->tree = new_rbtree();
+  pthread_mutex_init(&t->lock, NULL);
+  t->seq = 0;
+
+  return t;
+}
+
+// 더 이상 읽거나 쓰는 thread가 없을 때 호출해야 함
+void delete_seq_rbtree(seq_rbtree *t) {
+  pthread_mutex_destroy(&t->lock);
+  delete_rbtree(t->tree);
+  free(t);
+}
+
+// key 추가, 메모리가 부족하면 -1 반환
+int seq_rbtree_insert(seq_rbtree *t, const key_t key) {
+  write_begin(t);
+  node_t *p = rbtree_insert(t->tree, key);
+  write_end(t);
+
+  return (p == NULL) ? -1 : 0;
+}
+
+// key 하나 삭제, 없으면 -1 반환
+// 노드는 node pool로 돌아갈 뿐 반환되지 않으므로 읽는 중인 thread가 있어도 안전
+int seq_rbtree_erase(seq_rbtree *t, const key_t key) {
+  write_begin(t);
+  node_t *p = rbtree_find(t->tree, key);
+  if (p != NULL) {
+    rbtree_erase(t->tree, p);
+  }
+  write_end(t);
+
+  return (p == NULL) ? -1 : 0;
+}
+
+// key가 있으면 1, 없으면 0
+int seq_rbtree_contains(seq_rbtree *t, const key_t key) {
+  key_t found;
+
+  return seq_rbtree_lower_bound(t, key, &found) && found == key;
+}
+
+// key 이상인 첫 key를 *out에 저장하고 1 반환, 없으면 0 반환
+int seq_rbtree_lower_bound(seq_rbtree *t, const key_t key, key_t *out) {
+  node_t *p;
+
+  for (int i = 0; i < SEQ_RETRIES; i++) {
+    unsigned seq = read_begin(t);
+
+    if (seq & 1) {
+      continue;
+    }
+    if (walk_lower_bound(t->tree, key, &p) == 0) {
+      // key를 먼저 읽어 두고 검증해야 그 사이 노드가 재사용되어도 안전
+      key_t k = (p != NULL) ? LOAD(p->key) : 0;
+      if (!read_retry(t, seq)) {
+        *out = k;
+        return p != NULL;
+      }
+    }
+  }
+
+  // writer가 계속 바꾸고 있으면 lock을 잡고 읽음
+  pthread_mutex_lock(&t->lock);
+  walk_lower_bound(t->tree, key, &p);
+  if (p != NULL) {
+    *out = p->key;
+  }
+  pthread_mutex_unlock(&t->lock);
+
+  return p != NULL;
+}
+
+// lo 이상 hi 이하인 key를 최대 max개까지 key 순서대로 out에 복사하고 개수 반환
+size_t seq_rbtree_range(seq_rbtree *t, const key_t lo, const key_t hi, key_t *out,
+                        const size_t max) {
+  size_t count;
+
+  for (int i = 0; i < SEQ_RETRIES; i++) {
+    unsigned seq = read_begin(t);
+
+    if (seq & 1) {
+      continue;
+    }
+    if (walk_range(t->tree, lo, hi, out, max, &count) == 0 && !read_retry(t, seq)) {
+      return count;
+    }
+  }
+
+  pthread_mutex_lock(&t->lock);
+  walk_range(t->tree, lo, hi, out, max, &count);
+  pthread_mutex_unlock(&t->lock);
+
+  return count;
+}
+
+// Jiwon Functions
+
+// writer끼리는 lock으로 줄 세우고, 바꾸는 동안 seq를 홀수로 둠
+static void write_begin(seq_rbtree *t) {
+  pthread_mutex_lock(&t->lock);
+  __atomic_store_n(&t->seq, t->seq + 1, __ATOMIC_RELAXED);
+  // seq 증가가 tree를 바꾸는 store들보다 먼저 보이도록
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(seq_rbtree *t) {
+  __atomic_store_n(&t->seq, t->seq + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&t->lock);
+}
+
+static unsigned read_begin(const seq_rbtree *t) {
+  return __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+}
+
+// 읽는 동안 writer가 지나갔으면 1
+static int read_retry(const seq_rbtree *t, unsigned seq) {
+  // 앞에서 읽은 노드 필드들이 seq를 다시 읽기 전에 끝나도록
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&t->seq, __ATOMIC_RELAXED) != seq;
+}
+
+// key 이상인 첫 노드를 *found에 저장 (없으면 NULL)
+// 바뀌는 중인 tree를 보면 (NULL 포인터나 너무 긴 경로) -1 반환
+// 아직 쓰이지 않은 pool 노드는 0으로 채워져 있고, 반환된 노드도 pool 안에 남아 있으므로
+// 어떤 포인터를 읽어도 NULL이거나 유효한 메모리를 가리킴
+static int walk_lower_bound(const rbtree *t, const key_t key, node_t **found) {
+  node_t *x = LOAD(t->root);
+  node_t *res = NULL;
+
+  for (int depth = 0; x != t->nil; depth++) {
+    if (x == NULL || depth > SEQ_MAX_DEPTH) {
+      return -1;
+    }
+
+    if (LOAD(x->key) >= key) {
+      res = x;
+      x = LOAD(x->left);
+    } else {
+      x = LOAD(x->right);
+    }
+  }
+
+  *found = res;
+  return 0;
+}
+
+// *p를 key 순서로 다음 노드로 옮김 (끝이면 NULL), 바뀌는 중인 tree를 보면 -1
+static int walk_next(const rbtree *t, node_t **p) {
+  node_t *x = *p;
+  node_t *y = LOAD(x->right);
+
+  if (y == NULL) {
+    return -1;
+  }
+
+  // 오른쪽 subtree가 있으면 그 중 가장 작은 노드
+  if (y != t->nil) {
+    x = y;
+    for (int depth = 0; (y = LOAD(x->left)) != t->nil; depth++) {
+      if (y == NULL || depth > SEQ_MAX_DEPTH) {
+        return -1;
+      }
+      x = y;
+    }
+    *p = x;
+    return 0;
+  }
+
+  // 없으면 왼쪽 자식 쪽에서 올라오게 되는 첫 조상
+  for (int depth = 0;; depth++) {
+    y = LOAD(x->parent);
+    if (y == NULL || depth > SEQ_MAX_DEPTH) {
+      return -1;
+    }
+    if (y == t->nil || x != LOAD(y->right)) {
+      break;
+    }
+    x = y;
+  }
+
+  *p = (y == t->nil) ? NULL : y;
+  return 0;
+}
+
+static int walk_range(const rbtree *t, const key_t lo, const key_t hi, key_t *out,
+                      const size_t max, size_t *count) {
+  node_t *p;
+  size_t n = 0;
+
+  if (walk_lower_bound(t, lo, &p) < 0) {
+    return -1;
+  }
+
+  while (p != NULL && n < max) {
+    key_t k = LOAD(p->key);
+    if (k > hi) {
+      break;
+    }
+    out[n++] = k;
+    if (walk_next(t, &p) < 0) {
+      return -1;
+    }
+  }
+
+  *count = n;
+  return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef _RBTREE_SEQ_H_
+#define _RBTREE_SEQ_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// RB tree shared between threads. Writers serialize on a mutex and bump
+// a sequence count around every change; readers take no lock, walk the
+// tree optimistically and retry if the count moved (seqlock). Erased
+// nodes stay inside the tree's node pool until delete_seq_rbtree, so a
+// reader racing with a writer never touches freed memory.
+//
+// Readers get keys back by value, never node pointers, since a node may
+// be erased and reused as soon as the reader returns.
+
+typedef struct {
+  rbtree *tree;
+  pthread_mutex_t lock;  // held by writers
+  unsigned seq;          // odd while a writer is changing the tree
+} seq_rbtree;
+
+seq_rbtree *new_seq_rbtree(void);
+void delete_seq_rbtree(seq_rbtree *);
+
+// writers
+int seq_rbtree_insert(seq_rbtree *, const key_t);
+int seq_rbtree_erase(seq_rbtree *, const key_t);
+
+// lock-free readers
+int seq_rbtree_contains(seq_rbtree *, const key_t);
+int seq_rbtree_lower_bound(seq_rbtree *, const key_t, key_t *);
+size_t seq_rbtree_range(seq_rbtree *, const key_t, const key_t, key_t *, const size_t);
+
+#endif  // _RBTREE_SEQ_H_
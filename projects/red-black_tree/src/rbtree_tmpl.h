@@ -0,0 +1,472 @@
+// Generic key/value RB tree 템플릿
+//
+// 아래 매개변수를 정의한 뒤 이 파일을 include하면, 해당 key/value 타입 전용
+// RB tree 타입과 함수들이 static inline으로 생성됩니다.
+// 비교는 매크로로 펼쳐지므로 노드를 방문할 때마다 함수 포인터를 호출하지 않습니다.
+//
+//   #define RBT_NAME strmap                  // 타입과 함수 이름의 접두어 (필수)
+//   #define RBT_KEY const char *             // key 타입 (필수)
+//   #define RBT_VALUE int                    // value 타입 (생략하면 key만 저장하는 set)
+//   #define RBT_CMP(a, b) strcmp((a), (b))   // 음수/0/양수 반환 (생략하면 < 와 > 로 비교)
+//   #include "rbtree_tmpl.h"
+//
+// 생성되는 것들 (RBT_NAME이 strmap일 때):
+//   strmap, strmap_node
+//   strmap_new, strmap_delete, strmap_insert, strmap_find, strmap_erase,
+//   strmap_min, strmap_max, strmap_next, strmap_prev,
+//   strmap_lower_bound, strmap_upper_bound
+//
+// key와 value는 값으로 복사되어 저장되며, 포인터가 가리키는 내용은 호출하는 쪽이 관리합니다.
+// 매개변수들은 끝에서 #undef되므로 한 파일에서 여러 번 include할 수 있습니다.
+
+#include <stdlib.h>
+
+#include "rbtree.h"  // color_t
+
+#ifndef RBT_NAME
+#error "RBT_NAME must be defined before including rbtree_tmpl.h"
+#endif
+#ifndef RBT_KEY
+#error "RBT_KEY must be defined before including rbtree_tmpl.h"
+#endif
+#ifndef RBT_CMP
+#define RBT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+#endif
+
+#define RBT_CAT_(a, b) a##_##b
+#define RBT_CAT(a, b) RBT_CAT_(a, b)
+#define RBT_FN(f) RBT_CAT(RBT_NAME, f)
+#define RBT_NODE RBT_FN(node)
+
+typedef struct RBT_NODE {
+  color_t color;
+  RBT_KEY key;
+#ifdef RBT_VALUE
+  RBT_VALUE value;
+#endif
+  struct RBT_NODE *parent, *left, *right;
+} RBT_NODE;
+
+// nil은 tree 구조체 안에 두어 따로 할당하지 않음
+typedef struct {
+  RBT_NODE *root;
+  RBT_NODE nil;
+} RBT_NAME;
+
+// RB tree 구조체 생성, 메모리가 부족하면 NULL 반환
+static inline RBT_NAME *RBT_FN(new)(void) {
+  RBT_NAME *t = (RBT_NAME *)calloc(1, sizeof(RBT_NAME));
+
+  if (t == NULL) {
+    return NULL;
+  }
+
+  t->nil.color = RBTREE_BLACK;
+  t->root = &t->nil;
+
+  return t;
+}
+
+// 모든 노드와 tree 구조체 반환
+// 재귀 대신 자식이 없는 노드부터 부모 쪽으로 올라가며 반환
+static inline void RBT_FN(delete)(RBT_NAME *t) {
+  RBT_NODE *nil = &t->nil;
+  RBT_NODE *x = t->root;
+
+  while (x != nil) {
+    if (x->left != nil) {
+      x = x->left;
+    } else if (x->right != nil) {
+      x = x->right;
+    } else {
+      RBT_NODE *p = x->parent;
+
+      if (p != nil) {
+        if (p->left == x) {
+          p->left = nil;
+        } else {
+          p->right = nil;
+        }
+      }
+      free(x);
+      x = p;
+    }
+  }
+
+  free(t);
+}
+
+static inline void RBT_FN(left_rotate)(RBT_NAME *t, RBT_NODE *x) {
+  RBT_NODE *y = x->right;
+
+  x->right = y->left;
+  if (y->left != &t->nil) {
+    y->left->parent = x;
+  }
+  y->parent = x->parent;
+
+  if (x->parent == &t->nil) {
+    t->root = y;
+  } else if (x == x->parent->left) {
+    x->parent->left = y;
+  } else {
+    x->parent->right = y;
+  }
+
+  y->left = x;
+  x->parent = y;
+}
+
+static inline void RBT_FN(right_rotate)(RBT_NAME *t, RBT_NODE *x) {
+  RBT_NODE *y = x->left;
+
+  x->left = y->right;
+  if (y->right != &t->nil) {
+    y->right->parent = x;
+  }
+  y->parent = x->parent;
+
+  if (x->parent == &t->nil) {
+    t->root = y;
+  } else if (x == x->parent->right) {
+    x->parent->right = y;
+  } else {
+    x->parent->left = y;
+  }
+
+  y->right = x;
+  x->parent = y;
+}
+
+// rbtree.c의 rbtree_insert_fixup과 같은 세 가지 경우
+static inline void RBT_FN(insert_fixup)(RBT_NAME *t, RBT_NODE *z) {
+  while (z->parent->color == RBTREE_RED) {
+    RBT_NODE *g = z->parent->parent;
+
+    if (z->parent == g->left) {
+      RBT_NODE *y = g->right;
+
+      if (y->color == RBTREE_RED) {
+        z->parent->color = RBTREE_BLACK;
+        y->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        z = g;
+      } else {
+        if (z == z->parent->right) {
+          z = z->parent;
+          RBT_FN(left_rotate)(t, z);
+        }
+        z->parent->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        RBT_FN(right_rotate)(t, g);
+      }
+    } else {
+      RBT_NODE *y = g->left;
+
+      if (y->color == RBTREE_RED) {
+        z->parent->color = RBTREE_BLACK;
+        y->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        z = g;
+      } else {
+        if (z == z->parent->left) {
+          z = z->parent;
+          RBT_FN(right_rotate)(t, z);
+        }
+        z->parent->color = RBTREE_BLACK;
+        g->color = RBTREE_RED;
+        RBT_FN(left_rotate)(t, g);
+      }
+    }
+  }
+
+  t->root->color = RBTREE_BLACK;
+}
+
+// key (와 value) 추가 후 새 노드 반환, 메모리가 부족하면 NULL 반환
+// multiset이므로 같은 key가 있어도 하나 더 추가하며, 같은 key끼리는 삽입 순서를 유지
+#ifdef RBT_VALUE
+static inline RBT_NODE *RBT_FN(insert)(RBT_NAME *t, RBT_KEY key, RBT_VALUE value) {
+#else
+static inline RBT_NODE *RBT_FN(insert)(RBT_NAME *t, RBT_KEY key) {
+#endif
+  RBT_NODE *z = (RBT_NODE *)malloc(sizeof(RBT_NODE));
+  RBT_NODE *x = t->root;
+  RBT_NODE *y = &t->nil;
+  int c = 0;
+
+  if (z == NULL) {
+    return NULL;
+  }
+
+  while (x != &t->nil) {
+    y = x;
+    c = RBT_CMP(key, x->key);
+    x = (c < 0) ? x->left : x->right;
+  }
+
+  z->key = key;
+#ifdef RBT_VALUE
+  z->value = value;
+#endif
+  z->parent = y;
+  z->left = &t->nil;
+  z->right = &t->nil;
+  z->color = RBTREE_RED;
+
+  if (y == &t->nil) {
+    t->root = z;
+  } else if (c < 0) {
+    y->left = z;
+  } else {
+    y->right = z;
+  }
+
+  RBT_FN(insert_fixup)(t, z);
+
+  return z;
+}
+
+// key와 같은 노드 중 하나 반환, 없으면 NULL
+static inline RBT_NODE *RBT_FN(find)(const RBT_NAME *t, RBT_KEY key) {
+  RBT_NODE *x = t->root;
+
+  while (x != &t->nil) {
+    int c = RBT_CMP(key, x->key);
+
+    if (c < 0) {
+      x = x->left;
+    } else if (c > 0) {
+      x = x->right;
+    } else {
+      return x;
+    }
+  }
+
+  return NULL;
+}
+
+// key 이상인 첫 번째 노드 반환, 없으면 NULL
+static inline RBT_NODE *RBT_FN(lower_bound)(const RBT_NAME *t, RBT_KEY key) {
+  RBT_NODE *x = t->root;
+  RBT_NODE *found = NULL;
+
+  while (x != &t->nil) {
+    if (RBT_CMP(x->key, key) >= 0) {
+      found = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+
+  return found;
+}
+
+// key보다 큰 첫 번째 노드 반환, 없으면 NULL
+static inline RBT_NODE *RBT_FN(upper_bound)(const RBT_NAME *t, RBT_KEY key) {
+  RBT_NODE *x = t->root;
+  RBT_NODE *found = NULL;
+
+  while (x != &t->nil) {
+    if (RBT_CMP(x->key, key) > 0) {
+      found = x;
+      x = x->left;
+    } else {
+      x = x->right;
+    }
+  }
+
+  return found;
+}
+
+// 가장 작은 key의 노드 반환, 빈 tree면 NULL
+static inline RBT_NODE *RBT_FN(min)(const RBT_NAME *t) {
+  RBT_NODE *x = t->root;
+
+  if (x == &t->nil) {
+    return NULL;
+  }
+  while (x->left != &t->nil) {
+    x = x->left;
+  }
+
+  return x;
+}
+
+// 가장 큰 key의 노드 반환, 빈 tree면 NULL
+static inline RBT_NODE *RBT_FN(max)(const RBT_NAME *t) {
+  RBT_NODE *x = t->root;
+
+  if (x == &t->nil) {
+    return NULL;
+  }
+  while (x->right != &t->nil) {
+    x = x->right;
+  }
+
+  return x;
+}
+
+// key 순서로 다음 노드 반환, 마지막 노드면 NULL
+static inline RBT_NODE *RBT_FN(next)(const RBT_NAME *t, RBT_NODE *x) {
+  const RBT_NODE *nil = &t->nil;
+
+  // 오른쪽 subtree가 있으면 그 중 가장 작은 노드
+  if (x->right != nil) {
+    x = x->right;
+    while (x->left != nil) {
+      x = x->left;
+    }
+    return x;
+  }
+
+  // 없으면 왼쪽 자식으로 올라오는 첫 조상
+  while (x->parent != nil && x == x->parent->right) {
+    x = x->parent;
+  }
+
+  return (x->parent == nil) ? NULL : x->parent;
+}
+
+// key 순서로 이전 노드 반환, 첫 노드면 NULL
+static inline RBT_NODE *RBT_FN(prev)(const RBT_NAME *t, RBT_NODE *x) {
+  const RBT_NODE *nil = &t->nil;
+
+  if (x->left != nil) {
+    x = x->left;
+    while (x->right != nil) {
+      x = x->right;
+    }
+    return x;
+  }
+
+  while (x->parent != nil && x == x->parent->left) {
+    x = x->parent;
+  }
+
+  return (x->parent == nil) ? NULL : x->parent;
+}
+
+static inline void RBT_FN(transplant)(RBT_NAME *t, RBT_NODE *u, RBT_NODE *v) {
+  if (u->parent == &t->nil) {
+    t->root = v;
+  } else if (u == u->parent->left) {
+    u->parent->left = v;
+  } else {
+    u->parent->right = v;
+  }
+
+  v->parent = u->parent;
+}
+
+// rbtree.c의 rbtree_delete_fixup과 같은 네 가지 경우
+static inline void RBT_FN(delete_fixup)(RBT_NAME *t, RBT_NODE *x) {
+  while (x != t->root && x->color == RBTREE_BLACK) {
+    if (x == x->parent->left) {
+      RBT_NODE *w = x->parent->right;
+
+      if (w->color == RBTREE_RED) {
+        w->color = RBTREE_BLACK;
+        x->parent->color = RBTREE_RED;
+        RBT_FN(left_rotate)(t, x->parent);
+        w = x->parent->right;
+      }
+      if (w->left->color == RBTREE_BLACK && w->right->color == RBTREE_BLACK) {
+        w->color = RBTREE_RED;
+        x = x->parent;
+      } else {
+        if (w->right->color == RBTREE_BLACK) {
+          w->left->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          RBT_FN(right_rotate)(t, w);
+          w = x->parent->right;
+        }
+        w->color = x->parent->color;
+        x->parent->color = RBTREE_BLACK;
+        w->right->color = RBTREE_BLACK;
+        RBT_FN(left_rotate)(t, x->parent);
+        x = t->root;
+      }
+    } else {
+      RBT_NODE *w = x->parent->left;
+
+      if (w->color == RBTREE_RED) {
+        w->color = RBTREE_BLACK;
+        x->parent->color = RBTREE_RED;
+        RBT_FN(right_rotate)(t, x->parent);
+        w = x->parent->left;
+      }
+      if (w->right->color == RBTREE_BLACK && w->left->color == RBTREE_BLACK) {
+        w->color = RBTREE_RED;
+        x = x->parent;
+      } else {
+        if (w->left->color == RBTREE_BLACK) {
+          w->right->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          RBT_FN(left_rotate)(t, w);
+          w = x->parent->left;
+        }
+        w->color = x->parent->color;
+        x->parent->color = RBTREE_BLACK;
+        w->left->color = RBTREE_BLACK;
+        RBT_FN(right_rotate)(t, x->parent);
+        x = t->root;
+      }
+    }
+  }
+
+  x->color = RBTREE_BLACK;
+}
+
+// z 노드를 tree에서 떼어내고 메모리 반환
+static inline void RBT_FN(erase)(RBT_NAME *t, RBT_NODE *z) {
+  RBT_NODE *nil = &t->nil;
+  RBT_NODE *y = z;
+  color_t y_original_color = y->color;
+  RBT_NODE *x;
+
+  if (z->left == nil) {
+    x = z->right;
+    RBT_FN(transplant)(t, z, z->right);
+  } else if (z->right == nil) {
+    x = z->left;
+    RBT_FN(transplant)(t, z, z->left);
+  } else {
+    // Z의 successor Y가 Z 자리로 이동
+    y = z->right;
+    while (y->left != nil) {
+      y = y->left;
+    }
+    y_original_color = y->color;
+    x = y->right;
+
+    if (y->parent == z) {
+      x->parent = y;
+    } else {
+      RBT_FN(transplant)(t, y, y->right);
+      y->right = z->right;
+      y->right->parent = y;
+    }
+
+    RBT_FN(transplant)(t, z, y);
+    y->left = z->left;
+    y->left->parent = y;
+    y->color = z->color;
+  }
+
+  if (y_original_color == RBTREE_BLACK) {
+    RBT_FN(delete_fixup)(t, x);
+  }
+
+  free(z);
+}
+
+#undef RBT_NODE
+#undef RBT_FN
+#undef RBT_CAT
+#undef RBT_CAT_
+#undef RBT_NAME
+#undef RBT_KEY
+#undef RBT_VALUE
+#undef RBT_CMP
@@ -1,8 +1,30 @@
 #include <assert.h>
+#include <bptree.h>
+#include <crbtree.h>
+#include <prbtree.h>
+#include <pthread.h>
 #include <rbtree.h>
+#include <rbtree_seq.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// Every calloc in the test and in ../src goes through here (-Wl,--wrap=calloc).
+// Once calloc_fail_after reaches 0 calls fail, so a test can run the
+// out-of-memory paths; it stays at -1 (never fail) otherwise.
+void *__real_calloc(size_t nmemb, size_t size);
+static int calloc_fail_after = -1;
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  if (calloc_fail_after == 0) {
+    return NULL;
+  }
+  if (calloc_fail_after > 0) {
+    calloc_fail_after--;
+  }
+  return __real_calloc(nmemb, size);
+}
 
 // new_rbtree should return rbtree struct with null root node
 void test_init(void) {
@@ -367,6 +389,896 @@ void test_find_erase_rand(const size_t n, const unsigned int seed) {
   delete_rbtree(t);
 }
 
+// Subtree size constraint
+// The size of every node should be the number of nodes in its subtree
+
+static size_t size_traverse(const node_t *p, node_t *nil, bool *ok) {
+  if (p == nil) {
+    return 0;
+  }
+  size_t n = size_traverse(p->left, nil, ok) + size_traverse(p->right, nil, ok) + 1;
+  if (p->size != n) {
+    *ok = false;
+  }
+  return n;
+}
+
+void test_size_constraint(const rbtree *t) {
+  assert(t != NULL);
+#ifdef SENTINEL
+  node_t *nil = t->nil;
+#else
+  node_t *nil = NULL;
+#endif
+  bool ok = true;
+  size_traverse(t->root, nil, &ok);
+  assert(ok);
+}
+
+// select, rank, count_range and lower/upper bound should agree with a
+// sorted array of the same keys
+static void check_order_stats(const rbtree *t, const key_t *sorted, const size_t n) {
+  test_size_constraint(t);
+  assert(rbtree_size(t) == n);
+
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_select(t, i);
+    assert(p != NULL);
+    assert(p->key == sorted[i]);
+  }
+  assert(rbtree_select(t, n) == NULL);
+
+  // probe every key in the array and its neighbours
+  for (size_t i = 0; i < n; i++) {
+    for (key_t key = sorted[i] - 1; key <= sorted[i] + 1; key++) {
+      size_t lt = 0, le = 0;
+      while (lt < n && sorted[lt] < key) lt++;
+      while (le < n && sorted[le] <= key) le++;
+
+      assert(rbtree_rank(t, key) == lt);
+
+      node_t *lb = rbtree_lower_bound(t, key);
+      if (lt == n) {
+        assert(lb == NULL);
+      } else {
+        assert(lb != NULL && lb->key == sorted[lt]);
+      }
+      node_t *ub = rbtree_upper_bound(t, key);
+      if (le == n) {
+        assert(ub == NULL);
+      } else {
+        assert(ub != NULL && ub->key == sorted[le]);
+      }
+
+      key_t hi = sorted[(i + 3) % n];
+      size_t in_range = 0;
+      for (size_t j = 0; j < n; j++) {
+        if (sorted[j] >= key && sorted[j] <= hi) in_range++;
+      }
+      assert(rbtree_count_range(t, key, hi) == in_range);
+    }
+  }
+}
+
+void test_order_stats(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    // small range so that there are duplicates
+    arr[i] = rand() % (n / 2);
+    rbtree_insert(t, arr[i]);
+  }
+
+  key_t *sorted = calloc(n, sizeof(key_t));
+  memcpy(sorted, arr, n * sizeof(key_t));
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+  check_order_stats(t, sorted, n);
+
+  // erase every other key and check again
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i % 2 == 0) {
+      rbtree_erase(t, rbtree_find(t, arr[i]));
+    } else {
+      arr[m++] = arr[i];
+    }
+  }
+  memcpy(sorted, arr, m * sizeof(key_t));
+  qsort((void *)sorted, m, sizeof(key_t), comp);
+  test_color_constraint(t);
+  check_order_stats(t, sorted, m);
+
+  free(sorted);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// from_sorted_array should build a valid tree of every size, and
+// insert_many should merge keys in both its per-key and rebuild paths
+static void check_tree(const rbtree *t, const key_t *sorted, const size_t n) {
+  test_color_constraint(t);
+  test_search_constraint(t);
+  test_size_constraint(t);
+  assert(rbtree_size(t) == n);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  rbtree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == sorted[i]);
+  }
+  free(res);
+}
+
+void test_from_sorted_array(const size_t max_n) {
+  key_t *arr = calloc(max_n, sizeof(key_t));
+  for (size_t i = 0; i < max_n; i++) {
+    arr[i] = (key_t)(i / 3);  // with duplicates
+  }
+
+  for (size_t n = 0; n <= max_n; n += (n < 70) ? 1 : 997) {
+    rbtree *t = rbtree_from_sorted_array(arr, n);
+    assert(t != NULL);
+    check_tree(t, arr, n);
+    // the tree should keep working after the bulk build
+    if (n > 0) {
+      rbtree_erase(t, rbtree_find(t, arr[n / 2]));
+      rbtree_insert(t, arr[n / 2]);
+      check_tree(t, arr, n);
+    }
+    delete_rbtree(t);
+  }
+
+  free(arr);
+}
+
+void test_insert_many(const size_t n, const unsigned int seed) {
+  srand(seed);
+  rbtree *t = new_rbtree();
+  key_t *all = calloc(n, sizeof(key_t));
+  key_t *sorted = calloc(n, sizeof(key_t));
+  size_t m = 0;
+
+  // batches of different sizes go through both paths
+  const size_t batches[] = {n / 2, n / 100, 1, n / 4, n / 20, 0};
+  for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+    key_t *batch = all + m;
+    for (size_t i = 0; i < batches[b]; i++) {
+      batch[i] = rand() % (int)n;
+    }
+    assert(rbtree_insert_many(t, batch, batches[b]) == 0);
+    m += batches[b];
+
+    memcpy(sorted, all, m * sizeof(key_t));
+    qsort((void *)sorted, m, sizeof(key_t), comp);
+    check_tree(t, sorted, m);
+  }
+
+  free(sorted);
+  free(all);
+  delete_rbtree(t);
+}
+
+// a small batch that runs out of nodes partway must leave the tree as it was
+void test_insert_many_nomem(void) {
+  // fill the node pool up to the end of its 1024-node chunk, so the next
+  // chunk is only needed after the erased nodes on the free list run out
+  const size_t n = 32 + 64 + 128 + 256 + 512 + 1024, freed = 50;
+  rbtree *t = new_rbtree();
+  key_t *sorted = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = (key_t)i;
+    assert(rbtree_insert(t, sorted[i]) != NULL);
+  }
+  for (size_t i = 0; i < freed; i++) {
+    rbtree_erase(t, rbtree_find(t, sorted[n - 1 - i]));
+  }
+  const size_t m = n - freed;
+  check_tree(t, sorted, m);
+
+  key_t batch[100];
+  for (size_t i = 0; i < 100; i++) {
+    batch[i] = (key_t)(n + i);
+  }
+  assert(100 < m / 8);  // stays on the one-by-one path
+
+  calloc_fail_after = 0;
+  assert(rbtree_insert_many(t, batch, 100) == -1);
+  calloc_fail_after = -1;
+  check_tree(t, sorted, m);
+
+  // with memory back the same batch goes in whole
+  assert(rbtree_insert_many(t, batch, 100) == 0);
+  assert(rbtree_size(t) == m + 100);
+
+  free(sorted);
+  delete_rbtree(t);
+}
+
+// a batch big enough to rebuild the tree must keep the nodes the caller holds
+void test_insert_many_keeps_nodes(const size_t n) {
+  rbtree *t = new_rbtree();
+  node_t **held = calloc(n, sizeof(node_t *));
+  key_t *sorted = calloc(2 * n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    assert(rbtree_insert(t, (key_t)(2 * i)) != NULL);
+  }
+  for (size_t i = 0; i < n; i++) {
+    held[i] = rbtree_find(t, (key_t)(2 * i));
+  }
+
+  // odd keys and duplicates of the held keys, as many as the tree holds,
+  // so the batch takes the rebuild path
+  key_t *batch = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    batch[i] = (key_t)((i % 2 == 0) ? i + 1 : i - 1);
+  }
+
+  // the new nodes cannot be reserved, so nothing changes
+  calloc_fail_after = 0;
+  assert(rbtree_insert_many(t, batch, n) == -1);
+  calloc_fail_after = -1;
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = (key_t)(2 * i);
+  }
+  check_tree(t, sorted, n);
+
+  assert(rbtree_insert_many(t, batch, n) == 0);
+  for (size_t i = 0; i < n; i++) {
+    sorted[n + i] = batch[i];
+  }
+  qsort((void *)sorted, 2 * n, sizeof(key_t), comp);
+  check_tree(t, sorted, 2 * n);
+
+  // every held pointer is still a node of the tree with its own key
+  for (size_t i = 0; i < n; i++) {
+    assert(held[i]->key == (key_t)(2 * i));
+    assert(rbtree_erase(t, held[i]) == 0);
+  }
+  qsort((void *)batch, n, sizeof(key_t), comp);
+  check_tree(t, batch, n);
+
+  free(batch);
+  free(sorted);
+  free(held);
+  delete_rbtree(t);
+}
+
+// next/prev should walk the tree in key order, and range should visit
+// exactly the keys in [lo, hi] until the callback asks it to stop
+typedef struct {
+  const key_t *expect;
+  size_t seen, stop_after;
+} range_arg_t;
+
+static int range_visit(node_t *p, void *arg) {
+  range_arg_t *r = (range_arg_t *)arg;
+  assert(p->key == r->expect[r->seen]);
+  r->seen++;
+  return r->seen == r->stop_after;
+}
+
+void test_iterate(const size_t n, const unsigned int seed) {
+  srand(seed);
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % (int)n;
+  }
+  rbtree *t = new_rbtree();
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  node_t *p = rbtree_min(t);
+  for (size_t i = 0; i < n; i++, p = rbtree_next(t, p)) {
+    assert(p != NULL && p->key == arr[i]);
+  }
+  assert(p == NULL);
+  p = rbtree_max(t);
+  for (size_t i = n; i > 0; i--, p = rbtree_prev(t, p)) {
+    assert(p != NULL && p->key == arr[i - 1]);
+  }
+  assert(p == NULL);
+
+  // to_array should stop at n
+  key_t res[8] = {0};
+  rbtree_to_array(t, res, 4);
+  for (size_t i = 0; i < 4; i++) {
+    assert(res[i] == arr[i]);
+  }
+  assert(res[4] == 0);
+
+  for (size_t i = 0; i < n; i += 37) {
+    key_t lo = arr[i] - 1, hi = arr[(i * 7) % n];
+    size_t first = 0, last = 0;
+    while (first < n && arr[first] < lo) first++;
+    last = first;
+    while (last < n && arr[last] <= hi) last++;
+
+    range_arg_t r = {arr + first, 0, 0};
+    assert(rbtree_range(t, lo, hi, range_visit, &r) == last - first);
+    assert(r.seen == last - first);
+
+    if (last - first > 2) {
+      range_arg_t early = {arr + first, 0, 2};
+      assert(rbtree_range(t, lo, hi, range_visit, &early) == 2);
+    }
+  }
+
+  delete_rbtree(t);
+  free(arr);
+}
+
+// Shared RB tree: odd keys are inserted up front and never erased, while
+// writer threads keep inserting and erasing even keys. Lock-free readers
+// should always see every odd key and a sorted range around it.
+#define SEQ_KEYS 2000
+#define SEQ_ROUNDS 20000
+
+typedef struct {
+  seq_rbtree *t;
+  unsigned int seed;
+} seq_arg_t;
+
+static void *seq_writer(void *arg) {
+  seq_arg_t *a = (seq_arg_t *)arg;
+  for (int i = 0; i < SEQ_ROUNDS; i++) {
+    key_t key = 2 * (rand_r(&a->seed) % SEQ_KEYS);
+    if (rand_r(&a->seed) % 2) {
+      assert(seq_rbtree_insert(a->t, key) == 0);
+    } else {
+      seq_rbtree_erase(a->t, key);
+    }
+  }
+  return NULL;
+}
+
+static void *seq_reader(void *arg) {
+  seq_arg_t *a = (seq_arg_t *)arg;
+  key_t out[4];
+  for (int i = 0; i < SEQ_ROUNDS; i++) {
+    key_t key = 2 * (rand_r(&a->seed) % (SEQ_KEYS - 1)) + 1;
+    assert(seq_rbtree_contains(a->t, key));
+
+    key_t found;
+    assert(seq_rbtree_lower_bound(a->t, key - 1, &found));
+    assert(found == key - 1 || found == key);
+
+    // [key, key + 2] holds both odd ends and maybe copies of the even key between
+    size_t n = seq_rbtree_range(a->t, key, key + 2, out, 4);
+    assert(n >= 2);
+    assert(out[0] == key);
+    for (size_t j = 1; j < n; j++) {
+      assert(out[j] >= out[j - 1]);
+    }
+    assert(n == 4 || out[n - 1] == key + 2);
+  }
+  return NULL;
+}
+
+void test_seq_concurrent(const int writers, const int readers) {
+  seq_rbtree *t = new_seq_rbtree();
+  assert(t != NULL);
+  for (key_t k = 1; k < 2 * SEQ_KEYS; k += 2) {
+    assert(seq_rbtree_insert(t, k) == 0);
+  }
+
+  pthread_t tid[16];
+  seq_arg_t args[16];
+  assert(writers + readers <= 16);
+  for (int i = 0; i < writers + readers; i++) {
+    args[i].t = t;
+    args[i].seed = 17 + i;
+    pthread_create(&tid[i], NULL, (i < writers) ? seq_writer : seq_reader, &args[i]);
+  }
+  for (int i = 0; i < writers + readers; i++) {
+    pthread_join(tid[i], NULL);
+  }
+
+  test_color_constraint(t->tree);
+  test_search_constraint(t->tree);
+  test_size_constraint(t->tree);
+  for (key_t k = 1; k < 2 * SEQ_KEYS; k += 2) {
+    assert(seq_rbtree_contains(t, k));
+  }
+
+  delete_seq_rbtree(t);
+}
+
+// B+ tree: compare against a sorted reference array through inserts and
+// erases in random order, with enough duplicates that runs of equal keys
+// cross leaf and inner node boundaries
+static void check_bptree(const bptree *t, const key_t *sorted, const size_t n) {
+  assert(t->size == n);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  bptree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == sorted[i]);
+  }
+  free(res);
+
+  key_t k;
+  if (n == 0) {
+    assert(!bptree_min(t, &k) && !bptree_max(t, &k));
+  } else {
+    assert(bptree_min(t, &k) && k == sorted[0]);
+    assert(bptree_max(t, &k) && k == sorted[n - 1]);
+  }
+}
+
+static int bptree_visit(key_t key, void *arg) {
+  range_arg_t *r = (range_arg_t *)arg;
+  assert(key == r->expect[r->seen]);
+  r->seen++;
+  return r->seen == r->stop_after;
+}
+
+void test_bptree(const size_t n, const int range, const unsigned int seed) {
+  srand(seed);
+  bptree *t = new_bptree();
+  assert(t != NULL);
+  check_bptree(t, NULL, 0);
+
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t *sorted = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+    assert(bptree_insert(t, arr[i]) == 0);
+  }
+  memcpy(sorted, arr, n * sizeof(key_t));
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+  check_bptree(t, sorted, n);
+
+  for (size_t i = 0; i < n; i += n / 50 + 1) {
+    assert(bptree_find(t, arr[i]));
+    key_t lo = arr[i], hi = arr[i] + range / 100;
+    size_t first = 0, last;
+    while (first < n && sorted[first] < lo) first++;
+    for (last = first; last < n && sorted[last] <= hi; last++)
+      ;
+    range_arg_t r = {sorted + first, 0, 0};
+    assert(bptree_range(t, lo, hi, bptree_visit, &r) == last - first);
+    range_arg_t early = {sorted + first, 0, 1};
+    assert(bptree_range(t, lo, hi, bptree_visit, &early) == 1);
+  }
+  assert(!bptree_find(t, -1));
+  assert(bptree_erase(t, -1) == -1);
+
+  // erase in a shuffled order, checking the contents along the way
+  for (size_t i = n - 1; i > 0; i--) {
+    size_t j = rand() % (i + 1);
+    key_t tmp = arr[i];
+    arr[i] = arr[j];
+    arr[j] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) {
+    assert(bptree_erase(t, arr[i]) == 0);
+    if (i % (n / 8) == 0 || i == n - 1) {
+      size_t m = n - i - 1;
+      memcpy(sorted, arr + i + 1, m * sizeof(key_t));
+      qsort((void *)sorted, m, sizeof(key_t), comp);
+      check_bptree(t, sorted, m);
+    }
+  }
+  assert(!bptree_find(t, arr[0]));
+
+  free(sorted);
+  free(arr);
+  delete_bptree(t);
+}
+
+// Generic RB tree: string keys with int values, and struct keys without values
+
+#define RBT_NAME strmap
+#define RBT_KEY const char *
+#define RBT_VALUE int
+#define RBT_CMP(a, b) strcmp((a), (b))
+#include <rbtree_tmpl.h>
+
+typedef struct {
+  int major, minor;
+} version_t;
+
+#define RBT_NAME verset
+#define RBT_KEY version_t
+#define RBT_CMP(a, b) \
+  ((a).major != (b).major ? ((a).major > (b).major) - ((a).major < (b).major) \
+                          : ((a).minor > (b).minor) - ((a).minor < (b).minor))
+#include <rbtree_tmpl.h>
+
+static int strcomp(const void *p1, const void *p2) {
+  return strcmp(*(const char *const *)p1, *(const char *const *)p2);
+}
+
+void test_generic_strmap(const size_t n, const unsigned int seed) {
+  srand(seed);
+  strmap *t = strmap_new();
+  assert(t != NULL);
+  assert(strmap_min(t) == NULL);
+
+  char (*buf)[16] = calloc(n, sizeof(*buf));
+  const char **keys = calloc(n, sizeof(char *));
+  for (size_t i = 0; i < n; i++) {
+    snprintf(buf[i], sizeof(buf[i]), "k%d", rand() % (int)n);
+    keys[i] = buf[i];
+    strmap_node *p = strmap_insert(t, keys[i], (int)i);
+    assert(p != NULL && p->key == keys[i] && p->value == (int)i);
+  }
+
+  // every key should be found with a value that was inserted under it
+  for (size_t i = 0; i < n; i++) {
+    strmap_node *p = strmap_find(t, keys[i]);
+    assert(p != NULL);
+    assert(strcmp(p->key, keys[i]) == 0);
+    assert(strcmp(keys[p->value], keys[i]) == 0);
+  }
+  assert(strmap_find(t, "missing") == NULL);
+
+  // walk forward and backward in key order
+  qsort((void *)keys, n, sizeof(char *), strcomp);
+  strmap_node *p = strmap_min(t);
+  for (size_t i = 0; i < n; i++, p = strmap_next(t, p)) {
+    assert(p != NULL && strcmp(p->key, keys[i]) == 0);
+  }
+  assert(p == NULL);
+  p = strmap_max(t);
+  for (size_t i = n; i > 0; i--, p = strmap_prev(t, p)) {
+    assert(p != NULL && strcmp(p->key, keys[i - 1]) == 0);
+  }
+  assert(p == NULL);
+
+  // bounds around an existing key
+  const char *mid = keys[n / 2];
+  p = strmap_lower_bound(t, mid);
+  assert(p != NULL && strcmp(p->key, mid) == 0);
+  p = strmap_upper_bound(t, mid);
+  assert(p == NULL || strcmp(p->key, mid) > 0);
+  assert(strmap_upper_bound(t, keys[n - 1]) == NULL);
+
+  // erase everything through find
+  for (size_t i = 0; i < n; i++) {
+    p = strmap_find(t, keys[i]);
+    assert(p != NULL);
+    strmap_erase(t, p);
+  }
+  assert(t->root == &t->nil);
+
+  free(keys);
+  free(buf);
+  strmap_delete(t);
+}
+
+void test_generic_struct_key(void) {
+  const version_t vs[] = {{1, 2}, {0, 9}, {1, 10}, {2, 0}, {1, 2}, {0, 1}};
+  const version_t sorted[] = {{0, 1}, {0, 9}, {1, 2}, {1, 2}, {1, 10}, {2, 0}};
+  const size_t n = sizeof(vs) / sizeof(vs[0]);
+
+  verset *t = verset_new();
+  assert(t != NULL);
+  for (size_t i = 0; i < n; i++) {
+    assert(verset_insert(t, vs[i]) != NULL);
+  }
+
+  verset_node *p = verset_min(t);
+  for (size_t i = 0; i < n; i++, p = verset_next(t, p)) {
+    assert(p != NULL);
+    assert(p->key.major == sorted[i].major && p->key.minor == sorted[i].minor);
+  }
+  assert(p == NULL);
+
+  p = verset_lower_bound(t, (version_t){1, 3});
+  assert(p != NULL && p->key.major == 1 && p->key.minor == 10);
+
+  // free the rest without erasing
+  verset_delete(t);
+}
+
+// Compact RB tree: the same constraints checked through index links
+
+static int compact_black_height(const crbtree *t, const uint32_t x, const key_t lo,
+                                const key_t hi) {
+  if (x == CRBTREE_NIL) {
+    return 1;
+  }
+  const cnode_t *n = t->nodes;
+  const color_t color = (color_t)(n[x].parent_color & 1);
+  assert(n[x].key >= lo && n[x].key <= hi);
+  if (color == RBTREE_RED) {
+    assert((n[n[x].left].parent_color & 1) == RBTREE_BLACK);
+    assert((n[n[x].right].parent_color & 1) == RBTREE_BLACK);
+  }
+  if (n[x].left != CRBTREE_NIL) {
+    assert(n[n[x].left].parent_color >> 1 == x);
+  }
+  if (n[x].right != CRBTREE_NIL) {
+    assert(n[n[x].right].parent_color >> 1 == x);
+  }
+  const int l = compact_black_height(t, n[x].left, lo, n[x].key);
+  const int r = compact_black_height(t, n[x].right, n[x].key, hi);
+  assert(l == r);
+  return l + (color == RBTREE_BLACK ? 1 : 0);
+}
+
+static void check_compact(const crbtree *t, key_t *sorted, const size_t n) {
+  assert(t->root == CRBTREE_NIL || (t->nodes[t->root].parent_color & 1) == RBTREE_BLACK);
+  compact_black_height(t, t->root, -2147483647 - 1, 2147483647);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  crbtree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == sorted[i]);
+  }
+  free(res);
+
+  if (n > 0) {
+    assert(crbtree_key(t, crbtree_min(t)) == sorted[0]);
+    assert(crbtree_key(t, crbtree_max(t)) == sorted[n - 1]);
+  } else {
+    assert(crbtree_min(t) == CRBTREE_NIL);
+  }
+}
+
+void test_compact(const size_t n, const unsigned int seed) {
+  srand(seed);
+  crbtree *t = new_crbtree();
+  assert(t != NULL);
+  check_compact(t, NULL, 0);
+
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t *sorted = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % (int)n;
+    uint32_t x = crbtree_insert(t, arr[i]);
+    assert(x != CRBTREE_NIL && crbtree_key(t, x) == arr[i]);
+  }
+  memcpy(sorted, arr, n * sizeof(key_t));
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+  check_compact(t, sorted, n);
+
+  // erase every other key, then insert them again into the recycled slots
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t x = crbtree_find(t, arr[i]);
+    assert(x != CRBTREE_NIL && crbtree_key(t, x) == arr[i]);
+    if (i % 2 == 0) {
+      crbtree_erase(t, x);
+    } else {
+      sorted[m++] = arr[i];
+    }
+  }
+  qsort((void *)sorted, m, sizeof(key_t), comp);
+  check_compact(t, sorted, m);
+
+  const uint32_t cap = t->cap;
+  for (size_t i = 0; i < n; i += 2) {
+    crbtree_insert(t, arr[i]);
+  }
+  assert(t->cap == cap);
+  memcpy(sorted, arr, n * sizeof(key_t));
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+  check_compact(t, sorted, n);
+
+  free(sorted);
+  free(arr);
+  delete_crbtree(t);
+}
+
+// Persistent RB tree: snapshots taken along a run of inserts and erases
+// must keep their contents while the tree and the other snapshots change
+
+// black height of the subtree, checking the left-leaning RB rules on the way
+static int prb_black_height(const pnode_t *x) {
+  if (x == NULL) {
+    return 0;
+  }
+  assert(x->refs >= 1);
+  assert(x->right == NULL || x->right->color == RBTREE_BLACK);
+  if (x->color == RBTREE_RED) {
+    assert(x->left == NULL || x->left->color == RBTREE_BLACK);
+  }
+  int l = prb_black_height(x->left);
+  assert(l == prb_black_height(x->right));
+  return l + (x->color == RBTREE_BLACK);
+}
+
+static void check_prbtree(const prbtree *t, const key_t *sorted, const size_t n) {
+  assert(t->size == n);
+  assert(t->root == NULL || t->root->color == RBTREE_BLACK);
+  prb_black_height(t->root);
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  prbtree_to_array(t, res, n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == sorted[i]);
+  }
+  free(res);
+
+  key_t k;
+  if (n == 0) {
+    assert(!prbtree_min(t, &k) && !prbtree_max(t, &k));
+  } else {
+    assert(prbtree_min(t, &k) && k == sorted[0]);
+    assert(prbtree_max(t, &k) && k == sorted[n - 1]);
+  }
+}
+
+#define PRB_SNAPSHOTS 16
+
+void test_persistent(const size_t n, const unsigned int seed) {
+  srand(seed);
+  prbtree *t = new_prbtree();
+  assert(t != NULL);
+  check_prbtree(t, NULL, 0);
+
+  prbtree *snaps[PRB_SNAPSHOTS];
+  key_t *expect[PRB_SNAPSHOTS];
+  size_t sizes[PRB_SNAPSHOTS];
+  int s = 0;
+
+  key_t *arr = calloc(n, sizeof(key_t));
+  key_t *sorted = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % (int)(n / 2);
+    assert(prbtree_insert(t, arr[i]) == 0);
+  }
+  memcpy(sorted, arr, n * sizeof(key_t));
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+  check_prbtree(t, sorted, n);
+
+  for (size_t i = 0; i < n; i += n / 50 + 1) {
+    assert(prbtree_find(t, arr[i]));
+    key_t lo = arr[i], hi = arr[i] + 20;
+    size_t first = 0, last;
+    while (first < n && sorted[first] < lo) first++;
+    for (last = first; last < n && sorted[last] <= hi; last++)
+      ;
+    range_arg_t r = {sorted + first, 0, 0};
+    assert(prbtree_range(t, lo, hi, bptree_visit, &r) == last - first);
+    range_arg_t early = {sorted + first, 0, 1};
+    assert(prbtree_range(t, lo, hi, bptree_visit, &early) == 1);
+  }
+  assert(!prbtree_find(t, -1));
+  assert(prbtree_erase(t, -1) == -1);
+
+  // erase in a shuffled order while inserting new keys, taking snapshots along the way;
+  // cnt holds how many copies of each key the tree should have
+  for (size_t i = n - 1; i > 0; i--) {
+    size_t j = rand() % (i + 1);
+    key_t tmp = arr[i];
+    arr[i] = arr[j];
+    arr[j] = tmp;
+  }
+  const int range = (int)(n / 2);
+  size_t *cnt = calloc(range, sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    cnt[arr[i]]++;
+  }
+  size_t m = n;
+  for (size_t i = 0; i < n; i++) {
+    if (i % (n / PRB_SNAPSHOTS) == 0 && s < PRB_SNAPSHOTS) {
+      snaps[s] = prbtree_snapshot(t);
+      assert(snaps[s] != NULL && snaps[s]->root == t->root);
+      sizes[s] = m;
+      expect[s] = calloc(m + 1, sizeof(key_t));
+      size_t j = 0;
+      for (key_t k = 0; k < range; k++) {
+        for (size_t c = 0; c < cnt[k]; c++) {
+          expect[s][j++] = k;
+        }
+      }
+      s++;
+    }
+    assert(prbtree_erase(t, arr[i]) == 0);
+    cnt[arr[i]]--;
+    m--;
+    if (i % 3 == 0) {
+      key_t k = rand() % range;
+      assert(prbtree_insert(t, k) == 0);
+      cnt[k]++;
+      m++;
+    }
+  }
+  size_t j = 0;
+  for (key_t k = 0; k < range; k++) {
+    for (size_t c = 0; c < cnt[k]; c++) {
+      sorted[j++] = k;
+    }
+  }
+  check_prbtree(t, sorted, m);
+  free(cnt);
+
+  // every snapshot still holds what the tree had when it was taken
+  for (int i = 0; i < s; i++) {
+    check_prbtree(snaps[i], expect[i], sizes[i]);
+  }
+
+  // a snapshot can be changed on its own without touching the others
+  prbtree *fork = prbtree_snapshot(snaps[0]);
+  for (size_t i = 0; i < sizes[0]; i += 2) {
+    assert(prbtree_erase(fork, expect[0][i]) == 0);
+  }
+  for (int i = 0; i < s; i++) {
+    check_prbtree(snaps[i], expect[i], sizes[i]);
+  }
+  delete_prbtree(fork);
+
+  // drop the snapshots from both ends so shared nodes outlive some of their owners
+  for (int i = 0, j = s - 1; i <= j; i++, j--) {
+    delete_prbtree(snaps[i]);
+    free(expect[i]);
+    if (i < j) {
+      check_prbtree(snaps[j], expect[j], sizes[j]);
+      delete_prbtree(snaps[j]);
+      free(expect[j]);
+    }
+  }
+
+  free(sorted);
+  free(arr);
+  delete_prbtree(t);
+}
+
+// Snapshots handed to reader threads, which scan them and then drop them
+// while the main thread keeps changing the tree they share nodes with
+#define PRB_ROUNDS 8
+#define PRB_CHANGES 5000
+
+typedef struct {
+  prbtree *snap;
+  key_t *expect;
+  size_t n;
+} prb_arg_t;
+
+static void *prb_reader(void *arg) {
+  prb_arg_t *a = (prb_arg_t *)arg;
+  key_t *res = calloc(a->n + 1, sizeof(key_t));
+  for (int i = 0; i < 20; i++) {
+    prbtree_to_array(a->snap, res, a->n);
+    assert(memcmp(res, a->expect, a->n * sizeof(key_t)) == 0);
+  }
+  free(res);
+  delete_prbtree(a->snap);
+  free(a->expect);
+  return NULL;
+}
+
+void test_persistent_concurrent(const size_t n, const int readers) {
+  srand(17);
+  prbtree *t = new_prbtree();
+  for (size_t i = 0; i < n; i++) {
+    assert(prbtree_insert(t, rand() % (int)n) == 0);
+  }
+
+  pthread_t tid[16];
+  prb_arg_t args[16];
+  assert(readers <= 16);
+  for (int round = 0; round < PRB_ROUNDS; round++) {
+    for (int i = 0; i < readers; i++) {
+      args[i].snap = prbtree_snapshot(t);
+      args[i].n = t->size;
+      args[i].expect = calloc(t->size + 1, sizeof(key_t));
+      prbtree_to_array(t, args[i].expect, t->size);
+      pthread_create(&tid[i], NULL, prb_reader, &args[i]);
+
+      for (int j = 0; j < PRB_CHANGES; j++) {
+        key_t key = rand() % (int)n;
+        if (rand() % 2) {
+          assert(prbtree_insert(t, key) == 0);
+        } else {
+          prbtree_erase(t, key);
+        }
+      }
+    }
+    for (int i = 0; i < readers; i++) {
+      pthread_join(tid[i], NULL);
+    }
+  }
+
+  // every node the readers shared is back to a single owner
+  assert(t->root == NULL || t->root->refs == 1);
+  prb_black_height(t->root);
+  delete_prbtree(t);
+}
+
 int main(void) {
   test_init();
   test_insert_single(1024);
@@ -379,5 +1291,19 @@ int main(void) {
   test_duplicate_values();
   test_multi_instance();
   test_find_erase_rand(10000, 17);
+  test_order_stats(1000, 17);
+  test_from_sorted_array(100000);
+  test_insert_many(20000, 17);
+  test_insert_many_nomem();
+  test_insert_many_keeps_nodes(3000);
+  test_iterate(5000, 17);
+  test_seq_concurrent(2, 4);
+  test_bptree(100000, 1000000, 17);
+  test_bptree(100000, 300, 17);
+  test_generic_strmap(1000, 17);
+  test_generic_struct_key();
+  test_compact(10000, 17);
+  test_persistent(20000, 17);
+  test_persistent_concurrent(20000, 4);
   printf("Passed all tests!\n");
 }